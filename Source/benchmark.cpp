@@ -0,0 +1,801 @@
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <functional>
+#include <thread>
+#include <random>
+#include <unordered_map>
+#include <array>
+
+#include <glm/glm.hpp>
+#include <glm/gtc/constants.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+#include <glm/gtc/matrix_inverse.hpp>
+#include <glm/gtc/quaternion.hpp>
+
+#include "objParser.h"
+#include "frustum.h"
+#include "transformStore.h"
+#include "nbody.h"
+#include "simplify.h"
+#include "vertexCache.h"
+#include "quantize.h"
+#include "rangeAllocator.h"
+
+/* CPU-side benchmarks, no OpenGL context needed
+* usage : SOURCE_benchmark [section] [--faces N] [--objects N] [--transforms N] [--bodies N] [--bunnies N]
+* sections : obj, parallel, frustum, transforms, nbody, lod, vcache, quantize, pool (default : all)
+*/
+
+struct BenchOptions {
+	std::string section = "all";
+	long faces = 2000000;
+	long objects = 100000;
+	long transforms = 1000000;
+	long bodies = 1000000;
+	long bunnies = 10000;
+};
+
+//best wall time in milliseconds over a few runs
+double timeBest(int runs, const std::function<void()>& f) {
+	double best = 1e30;
+	for (int i = 0; i < runs; i++) {
+		auto start = std::chrono::steady_clock::now();
+		f();
+		auto end = std::chrono::steady_clock::now();
+		best = std::min(best, std::chrono::duration<double, std::milli>(end - start).count());
+	}
+	return best;
+}
+
+template<typename T>
+bool sameBytes(const std::vector<T>& a, const std::vector<T>& b) {
+	return a.size() == b.size() && (a.empty() || memcmp(a.data(), b.data(), sizeof(T) * a.size()) == 0);
+}
+
+bool sameObj(const ObjData& a, const ObjData& b) {
+	return sameBytes(a.positions, b.positions) && sameBytes(a.textures, b.textures)
+		&& sameBytes(a.normals, b.normals) && sameBytes(a.corners, b.corners);
+}
+
+//the getline/istringstream loader Object used before objParser.h, kept as a reference
+void loadObjLegacy(const char* path, ObjData& data) {
+	std::ifstream infile(path);
+	std::string line;
+	auto corner = [&](std::string f) {
+		std::string p, t, n;
+		p = f.substr(0, f.find("/"));
+		f.erase(0, f.find("/") + 1);
+		t = f.substr(0, f.find("/"));
+		f.erase(0, f.find("/") + 1);
+		n = f.substr(0, f.find("/"));
+		data.corners.push_back({ (int)std::stof(p) - 1, (int)std::stof(t) - 1, (int)std::stof(n) - 1 });
+	};
+	while (std::getline(infile, line))
+	{
+		std::istringstream iss(line);
+		std::string indice;
+		iss >> indice;
+		if (indice == "v") {
+			float x, y, z;
+			iss >> x >> y >> z;
+			data.positions.push_back(glm::vec3(x, y, z));
+		}
+		else if (indice == "vn") {
+			float x, y, z;
+			iss >> x >> y >> z;
+			data.normals.push_back(glm::vec3(x, y, z));
+		}
+		else if (indice == "vt") {
+			float u, v;
+			iss >> u >> v;
+			data.textures.push_back(glm::vec2(u, v));
+		}
+		else if (indice == "f") {
+			std::string f1, f2, f3;
+			iss >> f1 >> f2 >> f3;
+			corner(f1);
+			corner(f2);
+			corner(f3);
+		}
+	}
+}
+
+//UV sphere with about `faces` triangles, written the way Blender exports (p/t/n corners)
+void writeSyntheticObj(const char* path, long faces) {
+	int rings = (int)std::sqrt((double)faces / 2.0);
+	int segments = rings;
+	FILE* file = fopen(path, "w");
+	fprintf(file, "# synthetic sphere %d x %d\n", rings, segments);
+	for (int r = 0; r <= rings; r++) {
+		for (int s = 0; s <= segments; s++) {
+			float theta = glm::pi<float>() * r / rings;
+			float phi = 2.0f * glm::pi<float>() * s / segments;
+			glm::vec3 n(std::sin(theta) * std::cos(phi), std::cos(theta), std::sin(theta) * std::sin(phi));
+			fprintf(file, "v %f %f %f\n", n.x, n.y, n.z);
+			fprintf(file, "vt %f %f\n", (float)s / segments, (float)r / rings);
+			fprintf(file, "vn %.4f %.4f %.4f\n", n.x, n.y, n.z);
+		}
+	}
+	for (int r = 0; r < rings; r++) {
+		for (int s = 0; s < segments; s++) {
+			int a = r * (segments + 1) + s + 1;
+			int b = a + segments + 1;
+			fprintf(file, "f %d/%d/%d %d/%d/%d %d/%d/%d\n", a, a, a, b, b, b, a + 1, a + 1, a + 1);
+			fprintf(file, "f %d/%d/%d %d/%d/%d %d/%d/%d\n", a + 1, a + 1, a + 1, b, b, b, b + 1, b + 1, b + 1);
+		}
+	}
+	fclose(file);
+}
+
+void benchObjFile(const char* path) {
+	ObjData reference, mapped;
+	double legacyMs = timeBest(1, [&]() { reference = ObjData(); loadObjLegacy(path, reference); });
+	double mappedMs = timeBest(3, [&]() { mapped = ObjData(); loadObj(path, mapped, 1); });
+
+	std::cout << path << " : " << reference.positions.size() << " positions, " << reference.corners.size() / 3 << " faces" << std::endl;
+	std::cout << "  istringstream loader : " << legacyMs << " ms" << std::endl;
+	std::cout << "  mapped loader        : " << mappedMs << " ms (x" << legacyMs / mappedMs << ")" << std::endl;
+	std::cout << "  identical output     : " << (sameObj(reference, mapped) ? "yes" : "NO") << std::endl;
+}
+
+void benchObj(const BenchOptions& options) {
+	std::cout << "== OBJ parsing ==" << std::endl;
+	benchObjFile(PATH_TO_OBJECTS "/bunny_small.obj");
+
+	const char* synthetic = "synthetic.obj";
+	writeSyntheticObj(synthetic, options.faces);
+	benchObjFile(synthetic);
+	std::remove(synthetic);
+}
+
+//scaling of parseObjParallel with the number of threads, checked against the serial parse
+void benchParallelObj(const BenchOptions& options) {
+	std::cout << "== Parallel OBJ parsing ==" << std::endl;
+	const char* synthetic = "synthetic.obj";
+	writeSyntheticObj(synthetic, options.faces);
+	{
+		MappedFile file;
+		file.open(synthetic);
+		std::cout << "hardware threads : " << std::thread::hardware_concurrency() << std::endl;
+
+		ObjData serial;
+		double serialMs = timeBest(3, [&]() { serial = ObjData(); parseObj(file.data(), file.size(), serial); });
+		std::cout << "  serial     : " << serialMs << " ms" << std::endl;
+
+		for (unsigned threads = 1; threads <= 16; threads *= 2) {
+			ObjData parallel;
+			double ms = timeBest(3, [&]() { parallel = ObjData(); parseObjParallel(file.data(), file.size(), parallel, threads); });
+			std::cout << "  " << threads << " thread(s) : " << ms << " ms (x" << serialMs / ms << ")"
+				<< (sameObj(serial, parallel) ? "" : " OUTPUT DIFFERS") << std::endl;
+		}
+	}
+	std::remove(synthetic);
+}
+
+//frustum culling of a large scene : random spheres around a camera with the projection of the app
+void benchFrustum(const BenchOptions& options) {
+	std::cout << "== Frustum culling ==" << std::endl;
+	std::mt19937 random(502);
+	std::uniform_real_distribution<float> position(-50.0f, 50.0f);
+	std::uniform_real_distribution<float> radius(0.05f, 1.0f);
+
+	SphereSet spheres;
+	std::vector<glm::vec3> boxMin, boxMax;
+	for (long i = 0; i < options.objects; i++) {
+		BoundingSphere sphere = { glm::vec3(position(random), position(random), position(random)), radius(random) };
+		spheres.push_back(sphere);
+		boxMin.push_back(sphere.center - glm::vec3(sphere.radius));
+		boxMax.push_back(sphere.center + glm::vec3(sphere.radius));
+	}
+
+	glm::mat4 view = glm::lookAt(glm::vec3(0.0f), glm::vec3(0.0f, 0.0f, -1.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+	Frustum frustum(glm::perspective(45.0f, 1.0f, 0.01f, 100.0f) * view);
+
+	std::vector<uint8_t> scalarVisible, batchVisible;
+	int scalarDrawn = 0, batchDrawn = 0, perObjectDrawn = 0;
+	double scalarMs = timeBest(5, [&]() { scalarDrawn = frustum.cullScalar(spheres, scalarVisible); });
+	double batchMs = timeBest(5, [&]() { batchDrawn = frustum.cull(spheres, batchVisible); });
+	//what Object::isVisible does for each object : sphere then box
+	double perObjectMs = timeBest(5, [&]() {
+		perObjectDrawn = 0;
+		for (size_t i = 0; i < spheres.size(); i++) {
+			BoundingSphere sphere = { glm::vec3(spheres.x[i], spheres.y[i], spheres.z[i]), spheres.radius[i] };
+			if (frustum.intersects(sphere) && frustum.intersects(boxMin[i], boxMax[i])) perObjectDrawn++;
+		}
+	});
+
+	std::cout << spheres.size() << " objects : " << batchDrawn << " drawn, " << spheres.size() - batchDrawn << " culled" << std::endl;
+#ifndef FRUSTUM_SSE
+	std::cout << "  (no SSE in this build : the batch test is the scalar one)" << std::endl;
+#endif
+	std::cout << "  scalar spheres  : " << scalarMs << " ms (" << scalarMs * 1e6 / spheres.size() << " ns/object)" << std::endl;
+	std::cout << "  batch spheres   : " << batchMs << " ms (x" << scalarMs / batchMs << ", " << batchMs * 1e6 / spheres.size() << " ns/object)" << std::endl;
+	std::cout << "  sphere + box    : " << perObjectMs << " ms, " << perObjectDrawn << " drawn" << std::endl;
+	std::cout << "  identical output : " << (scalarDrawn == batchDrawn && scalarVisible == batchVisible ? "yes" : "NO") << std::endl;
+}
+
+//largest difference between two sets of matrices
+float maxDifference(const std::vector<glm::mat4>& a, const std::vector<glm::mat4>& b) {
+	float difference = 0.0f;
+	for (size_t i = 0; i < a.size(); i++) {
+		for (int c = 0; c < 4; c++) {
+			glm::vec4 d = glm::abs(a[i][c] - b[i][c]);
+			difference = std::max(difference, std::max(std::max(d.x, d.y), std::max(d.z, d.w)));
+		}
+	}
+	return difference;
+}
+
+//world and normal matrices of many objects : one Object-like struct per transform vs TransformStore
+void benchTransforms(const BenchOptions& options) {
+	std::cout << "== Transform updates ==" << std::endl;
+	std::mt19937 random(502);
+	std::uniform_real_distribution<float> position(-50.0f, 50.0f);
+	std::uniform_real_distribution<float> axis(-1.0f, 1.0f);
+	std::uniform_real_distribution<float> scale(0.1f, 2.0f);
+
+	//what main.cpp did per object : its own transform and matrices, glm::translate * rotate * scale then glm::inverseTranspose
+	struct ObjectTransform {
+		glm::vec3 position;
+		glm::quat rotation;
+		glm::vec3 scale;
+		glm::mat4 model, itM;
+	};
+	std::vector<ObjectTransform> objects(options.transforms);
+	TransformStore store;
+	for (ObjectTransform& object : objects) {
+		object.position = glm::vec3(position(random), position(random), position(random));
+		object.rotation = glm::angleAxis(glm::pi<float>() * axis(random), glm::normalize(glm::vec3(axis(random), axis(random), axis(random)) + glm::vec3(0.0f, 0.0f, 1e-3f)));
+		object.scale = glm::vec3(scale(random), scale(random), scale(random));
+		store.add(object.position, object.rotation, object.scale);
+	}
+
+	double objectMs = timeBest(3, [&]() {
+		for (ObjectTransform& object : objects) {
+			object.model = glm::translate(glm::mat4(1.0f), object.position) * glm::mat4_cast(object.rotation) * glm::scale(glm::mat4(1.0f), object.scale);
+			object.itM = glm::inverseTranspose(object.model);
+		}
+	});
+	double scalarMs = timeBest(3, [&]() { store.updateScalar(); });
+	std::vector<glm::mat4> scalarWorld = store.world, scalarNormal = store.normal;
+	double batchMs = timeBest(3, [&]() { store.update(); });
+
+	std::vector<glm::mat4> objectWorld(objects.size()), objectNormal(objects.size());
+	for (size_t i = 0; i < objects.size(); i++) {
+		objectWorld[i] = objects[i].model;
+		objectNormal[i] = objects[i].itM;
+	}
+
+	std::cout << objects.size() << " transforms (world + normal matrix)" << std::endl;
+#ifndef TRANSFORM_SSE
+	std::cout << "  (no SSE in this build : the batch update is the scalar one)" << std::endl;
+#endif
+	std::cout << "  per object (AoS, glm) : " << objectMs << " ms (" << objectMs * 1e6 / objects.size() << " ns/transform)" << std::endl;
+	std::cout << "  SoA scalar            : " << scalarMs << " ms (x" << objectMs / scalarMs << ")" << std::endl;
+	std::cout << "  SoA batch             : " << batchMs << " ms (x" << objectMs / batchMs << ", " << batchMs * 1e6 / objects.size() << " ns/transform)" << std::endl;
+	std::cout << "  max difference with glm : world " << maxDifference(store.world, objectWorld) << ", normal " << maxDifference(store.normal, objectNormal) << std::endl;
+	std::cout << "  batch vs scalar         : world " << maxDifference(store.world, scalarWorld) << ", normal " << maxDifference(store.normal, scalarNormal) << std::endl;
+}
+
+//random cluster of count bodies in a unit sphere, total mass 1
+void makeCluster(NBodySystem& bodies, long count) {
+	std::mt19937 random(502);
+	std::uniform_real_distribution<float> coordinate(-1.0f, 1.0f);
+	std::uniform_real_distribution<float> speed(-0.1f, 0.1f);
+	bodies.softening = 0.01f;
+	while ((long)bodies.size() < count) {
+		glm::vec3 p(coordinate(random), coordinate(random), coordinate(random));
+		if (glm::dot(p, p) > 1.0f) continue;
+		bodies.add(p, glm::vec3(speed(random), speed(random), speed(random)), 1.0f / count);
+	}
+}
+
+//root mean square of |a - reference| / |reference|
+double relativeError(const NBodySystem& a, const NBodySystem& reference) {
+	double sum = 0.0;
+	for (size_t i = 0; i < a.size(); i++) {
+		glm::dvec3 d(a.ax[i] - reference.ax[i], a.ay[i] - reference.ay[i], a.az[i] - reference.az[i]);
+		glm::dvec3 r(reference.ax[i], reference.ay[i], reference.az[i]);
+		sum += glm::dot(d, d) / std::max(1e-30, glm::dot(r, r));
+	}
+	return std::sqrt(sum / std::max<size_t>(1, a.size()));
+}
+
+//gravity of a cluster : every pair (scalar, SSE, threads) vs Barnes-Hut, then the energy of leapfrog over many steps
+void benchNBody(const BenchOptions& options) {
+	std::cout << "== N-body ==" << std::endl;
+	//above this every pair takes seconds per step
+	const long directLimit = 20000;
+	unsigned threads = std::max(1u, std::thread::hardware_concurrency());
+#ifndef NBODY_SSE
+	std::cout << "(no SSE in this build : the direct evaluation is the scalar one)" << std::endl;
+#endif
+	std::cout << threads << " threads, Barnes-Hut theta 0.5, times per evaluation of all accelerations" << std::endl;
+
+	for (long count = 10; count <= options.bodies; count *= 10) {
+		NBodySystem direct;
+		makeCluster(direct, count);
+		int runs = count <= 10000 ? 5 : 1;
+		std::cout << count << " bodies" << std::endl;
+
+		double scalarMs = 0.0;
+		if (count <= directLimit) {
+			direct.threads = 1;
+			scalarMs = timeBest(runs, [&]() { direct.accelerationsDirectScalar(); });
+			double sseMs = timeBest(runs, [&]() { direct.accelerationsDirect(); });
+			direct.threads = threads;
+			double threadedMs = timeBest(runs, [&]() { direct.accelerationsDirect(); });
+			double pairs = (double)count * count;
+			std::cout << "  direct scalar      : " << scalarMs << " ms (" << pairs / scalarMs * 1e-6 << " G pairs/s)" << std::endl;
+			std::cout << "  direct SSE         : " << sseMs << " ms (x" << scalarMs / sseMs << ")" << std::endl;
+			std::cout << "  direct SSE threads : " << threadedMs << " ms (x" << scalarMs / threadedMs << ")" << std::endl;
+		}
+		else {
+			std::cout << "  direct             : skipped (O(N^2), more than " << directLimit << " bodies)" << std::endl;
+		}
+
+		NBodySystem tree = direct;
+		tree.method = NBodySystem::BarnesHut;
+		tree.threads = threads;
+		double treeMs = timeBest(runs, [&]() { tree.accelerationsBarnesHut(); });
+		std::cout << "  Barnes-Hut         : " << treeMs << " ms (" << tree.treeSize() << " cells";
+		if (count <= directLimit) {
+			std::cout << ", x" << scalarMs / treeMs << ", error " << relativeError(tree, direct);
+		}
+		std::cout << ")" << std::endl;
+	}
+
+	//symplectic integration : the energy oscillates but does not drift
+	NBodySystem cluster;
+	makeCluster(cluster, 1000);
+	cluster.threads = threads;
+	double initial = cluster.energy();
+	double worst = 0.0;
+	for (int step = 1; step <= 1000; step++) {
+		cluster.step(1e-3f);
+		if (step % 100 == 0) worst = std::max(worst, std::abs(cluster.energy() - initial) / std::abs(initial));
+	}
+	std::cout << "leapfrog, 1000 bodies, 1000 steps : largest relative energy error " << worst
+		<< ", final " << (cluster.energy() - initial) / std::abs(initial) << std::endl;
+}
+
+//the Vertex of mesh.h, without OpenGL
+struct BenchVertex {
+	glm::vec3 Position;
+	glm::vec2 Texture;
+	glm::vec3 Normal;
+};
+
+//indexed mesh of an OBJ, identical corners share one vertex (as Mesh)
+void loadIndexed(const char* path, std::vector<BenchVertex>& vertices, std::vector<uint32_t>& indices) {
+	ObjData data;
+	loadObj(path, data);
+	std::unordered_map<VertexKey, uint32_t, VertexKeyHash> unique;
+	for (const VertexKey& key : data.corners) {
+		auto inserted = unique.emplace(key, (uint32_t)vertices.size());
+		if (inserted.second) {
+			BenchVertex v;
+			v.Position = data.positions.at(key.p);
+			v.Texture = key.t >= 0 ? data.textures.at(key.t) : glm::vec2(0.0f);
+			v.Normal = key.n >= 0 ? data.normals.at(key.n) : glm::vec3(0.0f);
+			vertices.push_back(v);
+		}
+		indices.push_back(inserted.first->second);
+	}
+}
+
+/* Quadric simplification of the meshes, then a field of bunnies seen by a camera flying over it :
+* triangles submitted per frame with the LOD of each bunny chosen from its size on screen, and the LOD switches
+* per frame with and without hysteresis.
+*/
+void benchLod(const BenchOptions& options) {
+	std::cout << "== Levels of detail ==" << std::endl;
+	std::vector<MeshLod> bunnyLods;
+	float bunnyRadius = 0.0f;
+	const char* paths[] = { PATH_TO_OBJECTS "/sphere_smooth.obj", PATH_TO_OBJECTS "/bunny_small.obj" };
+	for (const char* path : paths) {
+		std::vector<BenchVertex> baseVertices, vertices;
+		std::vector<uint32_t> baseIndices, indices;
+		loadIndexed(path, baseVertices, baseIndices);
+		std::vector<MeshLod> lods;
+		double ms = timeBest(3, [&]() {
+			vertices = baseVertices;
+			indices = baseIndices;
+			lods = buildLods(vertices, indices);
+		});
+		glm::vec3 low = vertices[0].Position, high = low;
+		for (size_t i = 0; i < baseVertices.size(); i++) {
+			low = glm::min(low, vertices[i].Position);
+			high = glm::max(high, vertices[i].Position);
+		}
+		float radius = 0.5f * glm::length(high - low);
+		std::cout << path << " : " << ms << " ms, " << vertices.size() - baseVertices.size() << " vertices added" << std::endl;
+		for (size_t l = 0; l < lods.size(); l++) {
+			std::cout << "  LOD " << l << " : " << lods[l].indexCount / 3 << " triangles, error " << lods[l].error
+				<< " (" << 100.0f * lods[l].error / radius << "% of the radius)" << std::endl;
+		}
+		bunnyLods = lods;
+		bunnyRadius = radius;
+	}
+
+	//bunnies of 1 unit on a square grid, the camera (projection and 1000 pixels viewport of the app) flies along the field
+	const float scale = 1.0f / bunnyRadius;
+	glm::mat4 projection = glm::perspective(45.0f, 1.0f, 0.01f, 100.0f);
+	const float pixelScale = projection[1][1] * 1000.0f / 2.0f;
+	int row = (int)std::ceil(std::sqrt((double)options.bunnies));
+	std::vector<glm::vec3> centers;
+	SphereSet spheres;
+	for (long i = 0; i < options.bunnies; i++) {
+		centers.push_back(glm::vec3(2.0f * (i % row - 0.5f * row), -1.0f, 2.0f * (i / row)));
+		spheres.push_back(BoundingSphere{ centers.back(), 1.0f });
+	}
+
+	const int frames = 200;
+	for (float hysteresis : { 0.25f, 0.0f }) {
+		std::vector<int> lod(centers.size(), 0);
+		std::vector<uint8_t> visible;
+		long long submitted = 0, full = 0, switches = 0;
+		for (int frame = 0; frame < frames; frame++) {
+			//slowly forward while swaying back and forth : the objects near a LOD limit cross it again and again
+			glm::vec3 eye(0.0f, 0.5f, -5.0f + 0.05f * frame + 0.5f * std::sin(0.3f * frame));
+			Frustum frustum(projection * glm::lookAt(eye, eye + glm::vec3(0.0f, -0.1f, 1.0f), glm::vec3(0.0f, 1.0f, 0.0f)));
+			frustum.cull(spheres, visible);
+			for (size_t i = 0; i < centers.size(); i++) {
+				if (!visible[i]) continue;
+				float distance = std::max(glm::length(centers[i] - eye) - 1.0f, 1e-3f);
+				int chosen = chooseLod(bunnyLods, lod[i], scale * pixelScale / distance, 1.0f, hysteresis);
+				//the first frame sets every LOD, it is not a switch
+				switches += frame > 0 && chosen != lod[i];
+				lod[i] = chosen;
+				submitted += bunnyLods[chosen].indexCount / 3;
+				full += bunnyLods[0].indexCount / 3;
+			}
+		}
+		std::cout << centers.size() << " bunnies, hysteresis " << hysteresis << " : " << (double)submitted / frames << " triangles per frame ("
+			<< (double)full / frames << " at full detail, x" << (double)full / std::max(1LL, submitted) << "), "
+			<< (double)switches / (frames - 1) << " LOD switches per frame" << std::endl;
+	}
+}
+
+/* Overdraw of a triangle order : the mesh is rasterized (depth test, no culling) from several directions,
+* fragments passing the depth test when they are drawn / pixels covered. 1 is no overdraw.
+*/
+double measureOverdraw(const std::vector<BenchVertex>& vertices, const uint32_t* indices, size_t indexCount) {
+	const int size = 256;
+	glm::vec3 low = vertices[indices[0]].Position, high = low;
+	for (size_t i = 0; i < indexCount; i++) {
+		low = glm::min(low, vertices[indices[i]].Position);
+		high = glm::max(high, vertices[indices[i]].Position);
+	}
+	glm::vec3 center = 0.5f * (low + high);
+	float radius = 0.5f * glm::length(high - low);
+
+	std::mt19937 random(502);
+	std::uniform_real_distribution<float> coordinate(-1.0f, 1.0f);
+	long long shaded = 0, covered = 0;
+	std::vector<float> depth(size * size);
+	for (int view = 0; view < 16; view++) {
+		glm::vec3 direction = glm::normalize(glm::vec3(coordinate(random), coordinate(random), coordinate(random)) + glm::vec3(0.0f, 0.0f, 1e-3f));
+		glm::mat4 camera = glm::lookAt(center - 2.0f * radius * direction, center, std::abs(direction.y) > 0.9f ? glm::vec3(1.0f, 0.0f, 0.0f) : glm::vec3(0.0f, 1.0f, 0.0f));
+		std::fill(depth.begin(), depth.end(), 1e30f);
+		for (size_t i = 0; i + 2 < indexCount; i += 3) {
+			glm::vec3 p[3];
+			for (int k = 0; k < 3; k++) {
+				glm::vec3 e = glm::vec3(camera * glm::vec4(vertices[indices[i + k]].Position, 1.0f));
+				//orthographic, the mesh fills the image
+				p[k] = glm::vec3((e.x / radius * 0.5f + 0.5f) * size, (e.y / radius * 0.5f + 0.5f) * size, -e.z);
+			}
+			float area = (p[1].x - p[0].x) * (p[2].y - p[0].y) - (p[2].x - p[0].x) * (p[1].y - p[0].y);
+			if (area == 0.0f) continue;
+			int x0 = std::max(0, (int)std::floor(std::min(p[0].x, std::min(p[1].x, p[2].x))));
+			int x1 = std::min(size - 1, (int)std::ceil(std::max(p[0].x, std::max(p[1].x, p[2].x))));
+			int y0 = std::max(0, (int)std::floor(std::min(p[0].y, std::min(p[1].y, p[2].y))));
+			int y1 = std::min(size - 1, (int)std::ceil(std::max(p[0].y, std::max(p[1].y, p[2].y))));
+			for (int y = y0; y <= y1; y++) {
+				for (int x = x0; x <= x1; x++) {
+					float px = x + 0.5f, py = y + 0.5f;
+					float w0 = ((p[1].x - px) * (p[2].y - py) - (p[2].x - px) * (p[1].y - py)) / area;
+					float w1 = ((p[2].x - px) * (p[0].y - py) - (p[0].x - px) * (p[2].y - py)) / area;
+					float w2 = 1.0f - w0 - w1;
+					if (w0 < 0.0f || w1 < 0.0f || w2 < 0.0f) continue;
+					float z = w0 * p[0].z + w1 * p[1].z + w2 * p[2].z;
+					float& stored = depth[y * size + x];
+					if (z < stored) {
+						covered += stored == 1e30f;
+						stored = z;
+						shaded++;
+					}
+				}
+			}
+		}
+	}
+	return covered ? (double)shaded / covered : 1.0;
+}
+
+/* Vertex fetch : the vertex shader runs (misses of a FIFO cache of 16) read their vertex through 64 byte lines kept
+* in a small LRU cache (64 lines), bytes loaded / bytes of the vertices used. 1 is every byte read once.
+*/
+double measureOverfetch(size_t vertexCount, const std::vector<uint32_t>& indices) {
+	const int cacheSize = 16, lineSize = 64, lines = 64;
+	std::vector<uint32_t> timestamp(vertexCount, 0);
+	std::vector<uint8_t> used(vertexCount, 0);
+	uint32_t time = cacheSize + 1;
+	std::vector<size_t> lineCache;
+	size_t loaded = 0, unique = 0;
+	for (uint32_t v : indices) {
+		if (!used[v]) {
+			used[v] = 1;
+			unique++;
+		}
+		if (time - timestamp[v] <= (uint32_t)cacheSize) continue;
+		timestamp[v] = time++;
+		size_t first = v * sizeof(BenchVertex) / lineSize, last = ((v + 1) * sizeof(BenchVertex) - 1) / lineSize;
+		for (size_t line = first; line <= last; line++) {
+			auto found = std::find(lineCache.begin(), lineCache.end(), line);
+			if (found != lineCache.end()) lineCache.erase(found);
+			else loaded++;
+			lineCache.insert(lineCache.begin(), line);
+			if (lineCache.size() > (size_t)lines) lineCache.pop_back();
+		}
+	}
+	return unique ? (double)loaded * lineSize / (unique * sizeof(BenchVertex)) : 1.0;
+}
+
+//ACMR / ATVR (FIFO caches of 16 and 32) and overdraw of an index buffer
+void printOrder(const char* name, const std::vector<BenchVertex>& vertices, const std::vector<uint32_t>& indices, double ms) {
+	VertexCacheStats fifo16 = analyzeVertexCache(indices.data(), indices.size(), vertices.size(), 16);
+	VertexCacheStats fifo32 = analyzeVertexCache(indices.data(), indices.size(), vertices.size(), 32);
+	std::cout << "  " << name << " : ACMR " << fifo16.acmr << " / " << fifo32.acmr << ", ATVR " << fifo16.atvr << " / " << fifo32.atvr
+		<< ", overdraw " << measureOverdraw(vertices, indices.data(), indices.size());
+	if (ms > 0.0) std::cout << " (" << ms << " ms)";
+	std::cout << std::endl;
+}
+
+//exact bits of a position : two different positions never share a key
+struct PositionKey {
+	uint32_t bits[3];
+
+	bool operator==(const PositionKey& other) const {
+		return bits[0] == other.bits[0] && bits[1] == other.bits[1] && bits[2] == other.bits[2];
+	}
+};
+
+struct PositionKeyHash {
+	size_t operator()(const PositionKey& key) const {
+		return (size_t)key.bits[0] * 73856093u ^ (size_t)key.bits[1] * 19349663u ^ (size_t)key.bits[2] * 83492791u;
+	}
+};
+
+/* Triangle orders of vertexCache.h on the meshes of the app, on the bunny with its positions welded (smooth normals)
+* and on a grid whose triangles are shuffled.
+*/
+void benchVertexCache() {
+	std::cout << "== Vertex cache and overdraw ==" << std::endl;
+	std::cout << "(ACMR and ATVR with FIFO caches of 16 / 32 vertices)" << std::endl;
+
+	std::vector<std::pair<std::string, std::pair<std::vector<BenchVertex>, std::vector<uint32_t>>>> meshes;
+	for (const char* name : { "sphere_smooth.obj", "bunny_small.obj" }) {
+		std::vector<BenchVertex> vertices;
+		std::vector<uint32_t> indices;
+		loadIndexed((std::string(PATH_TO_OBJECTS "/") + name).c_str(), vertices, indices);
+		meshes.push_back(std::make_pair(std::string(name), std::make_pair(vertices, indices)));
+
+		if (std::string(name) == "bunny_small.obj") {
+			//one vertex per position : what a smooth-shaded scan would share
+			std::vector<BenchVertex> welded;
+			std::vector<uint32_t> weldedIndices;
+			std::unordered_map<PositionKey, uint32_t, PositionKeyHash> ids;
+			for (uint32_t index : indices) {
+				PositionKey key;
+				memcpy(key.bits, &vertices[index].Position[0], sizeof(key.bits));
+				auto inserted = ids.emplace(key, (uint32_t)welded.size());
+				if (inserted.second) welded.push_back(vertices[index]);
+				weldedIndices.push_back(inserted.first->second);
+			}
+			meshes.push_back(std::make_pair(std::string("bunny_small.obj, welded"), std::make_pair(welded, weldedIndices)));
+		}
+	}
+	{
+		const int side = 200;
+		std::vector<BenchVertex> vertices;
+		std::vector<uint32_t> indices;
+		for (int y = 0; y <= side; y++) {
+			for (int x = 0; x <= side; x++) {
+				vertices.push_back(BenchVertex{ glm::vec3(x, y, std::sin(0.1f * x) * std::cos(0.1f * y)), glm::vec2(0.0f), glm::vec3(0.0f) });
+			}
+		}
+		std::vector<std::array<uint32_t, 3>> triangles;
+		for (int y = 0; y < side; y++) {
+			for (int x = 0; x < side; x++) {
+				uint32_t a = y * (side + 1) + x;
+				triangles.push_back({ { a, a + 1, a + side + 2 } });
+				triangles.push_back({ { a, a + side + 2, a + side + 1 } });
+			}
+		}
+		std::shuffle(triangles.begin(), triangles.end(), std::mt19937(502));
+		for (const auto& t : triangles) indices.insert(indices.end(), t.begin(), t.end());
+		meshes.push_back(std::make_pair(std::string("grid 200x200, shuffled"), std::make_pair(vertices, indices)));
+	}
+
+	for (auto& mesh : meshes) {
+		std::vector<BenchVertex>& vertices = mesh.second.first;
+		std::vector<uint32_t>& indices = mesh.second.second;
+		std::cout << mesh.first << " : " << indices.size() / 3 << " triangles, " << vertices.size() << " vertices" << std::endl;
+		printOrder("file order ", vertices, indices, 0.0);
+
+		std::vector<uint32_t> cacheOrder;
+		double cacheMs = timeBest(3, [&]() {
+			cacheOrder = indices;
+			optimizeVertexCache(cacheOrder.data(), cacheOrder.size(), vertices.size());
+		});
+		printOrder("Forsyth    ", vertices, cacheOrder, cacheMs);
+
+		std::vector<uint32_t> overdrawOrder;
+		double overdrawMs = timeBest(3, [&]() {
+			overdrawOrder = cacheOrder;
+			optimizeOverdraw(overdrawOrder.data(), overdrawOrder.size(), vertices.data(), vertices.size());
+		});
+		printOrder("+ overdraw ", vertices, overdrawOrder, overdrawMs);
+
+		std::vector<BenchVertex> fetchVertices = vertices;
+		std::vector<uint32_t> fetchOrder = overdrawOrder;
+		double fetchMs = timeBest(3, [&]() {
+			fetchVertices = vertices;
+			fetchOrder = overdrawOrder;
+			optimizeVertexFetch(fetchVertices, fetchOrder);
+		});
+		double fetchBefore = measureOverfetch(vertices.size(), overdrawOrder);
+		double fetchAfter = measureOverfetch(fetchVertices.size(), fetchOrder);
+		std::cout << "  vertex fetch : overfetch " << fetchBefore << " -> " << fetchAfter << " (" << fetchMs << " ms)"
+			<< (fetchAfter > fetchBefore ? ", WORSE than the original vertex order (see optimizeVertexFetch)" : "") << std::endl;
+	}
+}
+
+//packed vertex layout of quantize.h : size, time to pack and largest error against the float vertices
+void benchQuantize() {
+	std::cout << "== Packed vertices ==" << std::endl;
+	for (const char* name : { "sphere_smooth.obj", "bunny_small.obj" }) {
+		std::vector<BenchVertex> vertices;
+		std::vector<uint32_t> indices;
+		loadIndexed((std::string(PATH_TO_OBJECTS "/") + name).c_str(), vertices, indices);
+		glm::vec3 low = vertices[0].Position, high = low;
+		for (const BenchVertex& v : vertices) {
+			low = glm::min(low, v.Position);
+			high = glm::max(high, v.Position);
+		}
+
+		std::vector<PackedVertex> packed;
+		QuantizationError error;
+		double ms = timeBest(5, [&]() { error = packVertices(vertices.data(), vertices.size(), low, high, packed); });
+		std::cout << name << " : " << vertices.size() << " vertices, " << sizeof(BenchVertex) * vertices.size() / 1024 << " KB -> "
+			<< sizeof(PackedVertex) * packed.size() / 1024 << " KB (" << ms << " ms)" << std::endl;
+		std::cout << "  largest error : position " << error.position << " (" << 100.0f * error.relativePosition << "% of the box), normal "
+			<< error.normal << " degrees, texture " << error.texture << std::endl;
+	}
+}
+
+/* Free list of the geometry pool under runtime add/remove : a vertex range of 1M vertices is filled to 75%
+* with meshes of 100 to 50k vertices, then --objects times a random mesh is removed and new ones added up to 75% again.
+* A failed add (no free block large enough, the space being there) waits for the next removal :
+* the range does not grow here (the pool would), to measure the fragmentation alone.
+* Checks that no two live blocks overlap, reports the time per operation, the failed adds and the fragmentation.
+*/
+void benchPool(const BenchOptions& options) {
+	std::cout << "== Geometry pool allocator ==" << std::endl;
+	const size_t capacity = 1 << 20;
+	struct Block { size_t offset, size; };
+	std::mt19937 random(7);
+	//mesh sizes spread over orders of magnitude, as in a scene (log-uniform)
+	std::uniform_real_distribution<double> logSize(std::log(100.0), std::log(50000.0));
+	auto nextSize = [&]() { return (size_t)std::exp(logSize(random)); };
+
+	RangeAllocator allocator(capacity);
+	std::vector<Block> live;
+	const size_t target = capacity * 3 / 4;
+	while (allocator.used() < target) {
+		size_t size = nextSize();
+		live.push_back(Block{ allocator.allocate(size), size });
+	}
+	std::cout << live.size() << " meshes, " << 100.0 * allocator.used() / capacity << "% used" << std::endl;
+
+	long failed = 0;
+	size_t size = nextSize();
+	auto start = std::chrono::steady_clock::now();
+	for (long i = 0; i < options.objects; i++) {
+		size_t victim = random() % live.size();
+		allocator.release(live[victim].offset, live[victim].size);
+		live[victim] = live.back();
+		live.pop_back();
+		while (allocator.used() < target) {
+			size_t offset = allocator.allocate(size);
+			if (offset == RangeAllocator::invalid) {
+				failed++;
+				break;
+			}
+			live.push_back(Block{ offset, size });
+			size = nextSize();
+		}
+	}
+	double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+	//the live blocks and the free space must tile the range exactly
+	std::vector<uint8_t> owner(capacity, 0);
+	bool valid = true;
+	size_t liveUnits = 0;
+	for (const Block& block : live) {
+		liveUnits += block.size;
+		for (size_t u = block.offset; u < block.offset + block.size; u++) {
+			if (u >= capacity || owner[u]) valid = false;
+			else owner[u] = 1;
+		}
+	}
+	valid = valid && liveUnits == allocator.used();
+
+	std::cout << options.objects << " removals and their adds : " << 1e6 * ms / options.objects << " ns each, "
+		<< failed << " adds deferred (no block large enough)" << (valid ? "" : " (OVERLAP)") << std::endl;
+	std::cout << live.size() << " meshes, " << 100.0 * allocator.used() / capacity << "% used, " << allocator.freeBlocks() << " free blocks, largest "
+		<< allocator.largestFree() << ", fragmentation " << 100.0f * allocator.fragmentation() << "%" << std::endl;
+}
+
+
+int main(int argc, char* argv[])
+{
+	BenchOptions options;
+	for (int i = 1; i < argc; i++) {
+		std::string arg = argv[i];
+		if (arg == "--faces" && i + 1 < argc) {
+			options.faces = std::atol(argv[++i]);
+		}
+		else if (arg == "--objects" && i + 1 < argc) {
+			options.objects = std::atol(argv[++i]);
+		}
+		else if (arg == "--transforms" && i + 1 < argc) {
+			options.transforms = std::atol(argv[++i]);
+		}
+		else if (arg == "--bodies" && i + 1 < argc) {
+			options.bodies = std::atol(argv[++i]);
+		}
+		else if (arg == "--bunnies" && i + 1 < argc) {
+			options.bunnies = std::atol(argv[++i]);
+		}
+		else {
+			options.section = arg;
+		}
+	}
+
+	if (options.section == "all" || options.section == "obj") {
+		benchObj(options);
+	}
+	if (options.section == "all" || options.section == "parallel") {
+		benchParallelObj(options);
+	}
+	if (options.section == "all" || options.section == "frustum") {
+		benchFrustum(options);
+	}
+	if (options.section == "all" || options.section == "transforms") {
+		benchTransforms(options);
+	}
+	if (options.section == "all" || options.section == "nbody") {
+		benchNBody(options);
+	}
+	if (options.section == "all" || options.section == "lod") {
+		benchLod(options);
+	}
+	if (options.section == "all" || options.section == "vcache") {
+		benchVertexCache();
+	}
+	if (options.section == "all" || options.section == "quantize") {
+		benchQuantize();
+	}
+	if (options.section == "all" || options.section == "pool") {
+		benchPool(options);
+	}
+	return 0;
+}
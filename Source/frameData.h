@@ -0,0 +1,88 @@
+#ifndef FRAME_DATA_H
+#define FRAME_DATA_H
+
+#include <glad/glad.h>
+
+#include <string>
+#include <cstddef>
+
+#include <glm/glm.hpp>
+
+#include "shader.h"
+
+/* Per-frame data shared by every program :
+* camera and light live in one uniform buffer, written once per frame and bound at a fixed binding point,
+* instead of being uploaded to each program separately.
+*/
+
+// GLSL side, to put after the #version line of every shader reading the block
+const std::string frameDataGLSL =
+    "struct Light{\n"
+    "vec3 light_pos; \n"
+    "float ambient_strength; \n"
+    "float diffuse_strength; \n"
+    "float specular_strength; \n"
+    //attenuation factor
+    "float constant;\n"
+    "float linear;\n"
+    "float quadratic;\n"
+    "};\n"
+    "layout(std140) uniform FrameData{\n"
+    "mat4 V; \n"
+    "mat4 P; \n"
+    "vec3 u_view_pos; \n"
+    "Light light; \n"
+    "};\n";
+
+// C++ side, must follow the std140 layout of the block above
+struct FrameData {
+    glm::mat4 V;
+    glm::mat4 P;
+    glm::vec4 viewPos;     // vec3 padded to 16 bytes
+    glm::vec3 lightPos;    // struct Light starts on a 16 bytes boundary
+    float ambientStrength;
+    float diffuseStrength;
+    float specularStrength;
+    float constant;
+    float linear;
+    float quadratic;
+    float padding[3];      // a struct is padded to a multiple of 16 bytes
+};
+
+static_assert(offsetof(FrameData, viewPos) == 128, "std140 layout of FrameData");
+static_assert(offsetof(FrameData, lightPos) == 144, "std140 layout of FrameData");
+static_assert(offsetof(FrameData, quadratic) == 176, "std140 layout of FrameData");
+static_assert(sizeof(FrameData) == 192, "std140 layout of FrameData");
+
+class FrameUniforms
+{
+public:
+    static const GLuint binding = 0;
+
+    FrameData data = FrameData();
+
+    FrameUniforms() {
+        glGenBuffers(1, &UBO);
+        glBindBuffer(GL_UNIFORM_BUFFER, UBO);
+        glBufferData(GL_UNIFORM_BUFFER, sizeof(FrameData), nullptr, GL_DYNAMIC_DRAW);
+        glBindBuffer(GL_UNIFORM_BUFFER, 0);
+        glBindBufferBase(GL_UNIFORM_BUFFER, binding, UBO);
+    }
+
+    // make the FrameData block of this program read from the shared buffer
+    void attach(Shader& shader) {
+        shader.bindUniformBlock("FrameData", binding);
+    }
+
+    // upload the whole block, once per frame
+    void update() {
+        glBindBuffer(GL_UNIFORM_BUFFER, UBO);
+        glBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(FrameData), &data);
+        glBindBuffer(GL_UNIFORM_BUFFER, 0);
+    }
+
+private:
+    GLuint UBO;
+};
+
+#endif
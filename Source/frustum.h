@@ -0,0 +1,167 @@
+#ifndef FRUSTUM_H
+#define FRUSTUM_H
+
+#include <vector>
+#include <cstdint>
+#include <cmath>
+#include <algorithm>
+
+#include <glm/glm.hpp>
+
+#if defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+#include <xmmintrin.h>
+#define FRUSTUM_SSE
+#endif
+
+/* Frustum culling : the objects whose bounding volume is entirely outside one of the six planes of the camera
+* are not drawn (no uniform upload, no draw call).
+* The planes come from the projection * view matrix (Gribb & Hartmann), they point inside and are normalized
+* so that dot(plane, (p, 1)) is a distance.
+*/
+
+struct BoundingSphere {
+	glm::vec3 center;
+	float radius;
+};
+
+//sphere of a mesh placed with model (a non uniform scale takes the largest axis)
+inline BoundingSphere transformSphere(const BoundingSphere& sphere, const glm::mat4& model) {
+	float scale = std::max(glm::dot(glm::vec3(model[0]), glm::vec3(model[0])), std::max(glm::dot(glm::vec3(model[1]), glm::vec3(model[1])), glm::dot(glm::vec3(model[2]), glm::vec3(model[2]))));
+	return BoundingSphere{ glm::vec3(model * glm::vec4(sphere.center, 1.0)), sphere.radius * std::sqrt(scale) };
+}
+
+//box of a mesh placed with model, still aligned with the world axes (Arvo)
+inline void transformBounds(const glm::vec3& boundsMin, const glm::vec3& boundsMax, const glm::mat4& model, glm::vec3& worldMin, glm::vec3& worldMax) {
+	worldMin = worldMax = glm::vec3(model[3]);
+	for (int column = 0; column < 3; column++) {
+		glm::vec3 a = glm::vec3(model[column]) * boundsMin[column];
+		glm::vec3 b = glm::vec3(model[column]) * boundsMax[column];
+		worldMin += glm::min(a, b);
+		worldMax += glm::max(a, b);
+	}
+}
+
+//many spheres, one array per coordinate for the batch test
+struct SphereSet {
+	std::vector<float> x, y, z, radius;
+
+	void push_back(const BoundingSphere& sphere) {
+		x.push_back(sphere.center.x);
+		y.push_back(sphere.center.y);
+		z.push_back(sphere.center.z);
+		radius.push_back(sphere.radius);
+	}
+
+	size_t size() const {
+		return x.size();
+	}
+
+	void clear() {
+		x.clear();
+		y.clear();
+		z.clear();
+		radius.clear();
+	}
+};
+
+class Frustum
+{
+public:
+	//left, right, bottom, top, near, far
+	glm::vec4 planes[6];
+
+	Frustum() = default;
+
+	explicit Frustum(const glm::mat4& viewProjection) {
+		//rows of the matrix (glm is column major)
+		glm::vec4 rows[4];
+		for (int i = 0; i < 4; i++) {
+			rows[i] = glm::vec4(viewProjection[0][i], viewProjection[1][i], viewProjection[2][i], viewProjection[3][i]);
+		}
+		for (int i = 0; i < 3; i++) {
+			planes[2 * i] = rows[3] + rows[i];
+			planes[2 * i + 1] = rows[3] - rows[i];
+		}
+		for (glm::vec4& plane : planes) {
+			plane /= glm::length(glm::vec3(plane));
+		}
+	}
+
+	bool intersects(const BoundingSphere& sphere) const {
+		for (const glm::vec4& plane : planes) {
+			if (glm::dot(glm::vec3(plane), sphere.center) + plane.w < -sphere.radius) return false;
+		}
+		return true;
+	}
+
+	//the corner of the box the furthest along the plane normal must be inside
+	bool intersects(const glm::vec3& boundsMin, const glm::vec3& boundsMax) const {
+		for (const glm::vec4& plane : planes) {
+			glm::vec3 corner(plane.x >= 0.0f ? boundsMax.x : boundsMin.x, plane.y >= 0.0f ? boundsMax.y : boundsMin.y, plane.z >= 0.0f ? boundsMax.z : boundsMin.z);
+			if (glm::dot(glm::vec3(plane), corner) + plane.w < 0.0f) return false;
+		}
+		return true;
+	}
+
+	//visible[i] = 1 if sphere i is at least partly inside, returns the number of visible spheres
+	int cullScalar(const SphereSet& spheres, std::vector<uint8_t>& visible) const {
+		visible.resize(spheres.size());
+		return cullRange(spheres, visible, 0);
+	}
+
+	//same result as cullScalar, four spheres at a time with SSE when it is available
+	int cull(const SphereSet& spheres, std::vector<uint8_t>& visible) const {
+		visible.resize(spheres.size());
+#ifdef FRUSTUM_SSE
+		size_t count = spheres.size();
+		size_t batched = count & ~(size_t)3;
+		int inside = 0;
+
+		__m128 px[6], py[6], pz[6], pw[6];
+		for (int p = 0; p < 6; p++) {
+			px[p] = _mm_set1_ps(planes[p].x);
+			py[p] = _mm_set1_ps(planes[p].y);
+			pz[p] = _mm_set1_ps(planes[p].z);
+			pw[p] = _mm_set1_ps(planes[p].w);
+		}
+		const __m128 zero = _mm_setzero_ps();
+
+		for (size_t i = 0; i < batched; i += 4) {
+			__m128 x = _mm_loadu_ps(&spheres.x[i]);
+			__m128 y = _mm_loadu_ps(&spheres.y[i]);
+			__m128 z = _mm_loadu_ps(&spheres.z[i]);
+			__m128 negRadius = _mm_sub_ps(zero, _mm_loadu_ps(&spheres.radius[i]));
+
+			//all ones while the sphere is in front of every plane tested so far
+			__m128 mask = _mm_cmpeq_ps(zero, zero);
+			for (int p = 0; p < 6; p++) {
+				//same order of operations as intersects() : the results are identical
+				__m128 distance = _mm_add_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(px[p], x), _mm_mul_ps(py[p], y)), _mm_mul_ps(pz[p], z)), pw[p]);
+				mask = _mm_and_ps(mask, _mm_cmpge_ps(distance, negRadius));
+			}
+
+			int bits = _mm_movemask_ps(mask);
+			for (int j = 0; j < 4; j++) {
+				visible[i + j] = (bits >> j) & 1;
+				inside += visible[i + j];
+			}
+		}
+		return inside + cullRange(spheres, visible, batched);
+#else
+		return cullRange(spheres, visible, 0);
+#endif
+	}
+
+private:
+	int cullRange(const SphereSet& spheres, std::vector<uint8_t>& visible, size_t first) const {
+		int inside = 0;
+		for (size_t i = first; i < spheres.size(); i++) {
+			BoundingSphere sphere = { glm::vec3(spheres.x[i], spheres.y[i], spheres.z[i]), spheres.radius[i] };
+			visible[i] = intersects(sphere);
+			inside += visible[i];
+		}
+		return inside;
+	}
+};
+
+#endif
@@ -0,0 +1,164 @@
+#ifndef GEOMETRY_POOL_H
+#define GEOMETRY_POOL_H
+
+#include <cstddef>
+#include <algorithm>
+
+#include <glad/glad.h>
+
+#include "rangeAllocator.h"
+#include "glState.h"
+#include "vertexLayout.h"
+
+//where a mesh lives in a GeometryPool : its indices are relative to baseVertex (glDrawElementsBaseVertex)
+struct PoolAllocation {
+	size_t baseVertex = 0;
+	size_t vertexCount = 0;
+	size_t firstIndex = 0;
+	size_t indexCount = 0;
+};
+
+/* Geometry pool : the static meshes of one vertex format in a single vertex buffer and a single index buffer.
+* The meshes are suballocated (RangeAllocator) when they are uploaded and freed with them, so they can come and go at runtime.
+* All of them are drawn through the one VAO of the pool, whatever the program : switching objects binds no VAO and no buffer.
+* The buffers start at the size of the first mesh. When a mesh does not fit, a buffer is replaced by one half as large again
+* (or large enough : the copies stay amortized, at most a third of the buffer is free space) and the content is copied on the GPU (glCopyBufferSubData) : the names of the buffers change,
+* generation() counts these changes for the VAOs built outside of the pool. The VAO of the pool is updated.
+* The buffers are deleted with the last mesh, while the context still exists.
+*/
+class GeometryPool
+{
+public:
+	//off : every mesh gets its own buffers (for comparison)
+	bool enabled = true;
+
+	explicit GeometryPool(VertexFormat format) : format(format), vertexSize(vertexStride(format)) {
+	}
+
+	GeometryPool(const GeometryPool&) = delete;
+	GeometryPool& operator=(const GeometryPool&) = delete;
+
+	//copy a mesh into the pool (growing it if needed), false if it is off
+	bool allocate(const void* vertexData, size_t vertexCount, const GLuint* indexData, size_t indexCount, PoolAllocation& allocation) {
+		if (!enabled || vertexCount == 0 || indexCount == 0) return false;
+		//no buffer yet : the first grow() sizes them for this mesh
+		if (!VAO) VAO = createVertexArray(format, 0, 0);
+		size_t baseVertex = vertexRanges.allocate(vertexCount);
+		if (baseVertex == RangeAllocator::invalid) {
+			grow(VBO, vertexRanges, vertexSize, vertexCount);
+			baseVertex = vertexRanges.allocate(vertexCount);
+		}
+		size_t firstIndex = indexRanges.allocate(indexCount);
+		if (firstIndex == RangeAllocator::invalid) {
+			grow(EBO, indexRanges, sizeof(GLuint), indexCount);
+			firstIndex = indexRanges.allocate(indexCount);
+		}
+
+		//GL_COPY_WRITE_BUFFER : binding GL_ELEMENT_ARRAY_BUFFER here would change the currently bound VAO
+		glBindBuffer(GL_COPY_WRITE_BUFFER, VBO);
+		glBufferSubData(GL_COPY_WRITE_BUFFER, vertexSize * baseVertex, vertexSize * vertexCount, vertexData);
+		glBindBuffer(GL_COPY_WRITE_BUFFER, EBO);
+		glBufferSubData(GL_COPY_WRITE_BUFFER, sizeof(GLuint) * firstIndex, sizeof(GLuint) * indexCount, indexData);
+		glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+
+		allocation.baseVertex = baseVertex;
+		allocation.vertexCount = vertexCount;
+		allocation.firstIndex = firstIndex;
+		allocation.indexCount = indexCount;
+		allocations++;
+		return true;
+	}
+
+	//the space of a mesh is free again (its data stays in the buffer until overwritten, the buffers do not shrink)
+	void release(const PoolAllocation& allocation) {
+		vertexRanges.release(allocation.baseVertex, allocation.vertexCount);
+		indexRanges.release(allocation.firstIndex, allocation.indexCount);
+		if (--allocations == 0) deleteBuffers();
+	}
+
+	GLuint vertexBuffer() const {
+		return VBO;
+	}
+
+	GLuint indexBuffer() const {
+		return EBO;
+	}
+
+	//VAO of every mesh of the pool
+	GLuint vertexArray() const {
+		return VAO;
+	}
+
+	//incremented each time vertexBuffer() or indexBuffer() changes
+	int generation() const {
+		return grows;
+	}
+
+	//statistics
+	int meshes() const {
+		return allocations;
+	}
+
+	size_t residentBytes() const {
+		return vertexSize * vertexRanges.used() + sizeof(GLuint) * indexRanges.used();
+	}
+
+	size_t capacityBytes() const {
+		return vertexSize * vertexRanges.capacity() + sizeof(GLuint) * indexRanges.capacity();
+	}
+
+	const RangeAllocator& vertices() const {
+		return vertexRanges;
+	}
+
+	const RangeAllocator& indices() const {
+		return indexRanges;
+	}
+
+private:
+	VertexFormat format;
+	size_t vertexSize;
+	RangeAllocator vertexRanges;
+	RangeAllocator indexRanges;
+	int allocations = 0;
+	int grows = 0;
+	GLuint VBO = 0, EBO = 0, VAO = 0;
+
+	//replace buffer by a larger one (room for at least count more units at the end) holding the same data
+	void grow(GLuint& buffer, RangeAllocator& ranges, size_t unitSize, size_t count) {
+		size_t oldCapacity = ranges.capacity();
+		size_t capacity = oldCapacity + std::max(oldCapacity / 2, count);
+		GLuint larger;
+		glGenBuffers(1, &larger);
+		glBindBuffer(GL_COPY_WRITE_BUFFER, larger);
+		glBufferData(GL_COPY_WRITE_BUFFER, unitSize * capacity, nullptr, GL_STATIC_DRAW);
+		if (oldCapacity > 0) {
+			glBindBuffer(GL_COPY_READ_BUFFER, buffer);
+			glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0, 0, unitSize * oldCapacity);
+			glBindBuffer(GL_COPY_READ_BUFFER, 0);
+		}
+		glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+		if (buffer) glDeleteBuffers(1, &buffer);
+		buffer = larger;
+		ranges.grow(capacity);
+		grows++;
+
+		glState().bindVertexArray(VAO);
+		glBindVertexBuffer(vertexBinding, VBO, 0, vertexSize);
+		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
+		glState().bindVertexArray(0);
+	}
+
+	void deleteBuffers() {
+		//the name may be reused by a later VAO : do not leave it in the state cache
+		glState().bindVertexArray(0);
+		glDeleteVertexArrays(1, &VAO);
+		glDeleteBuffers(1, &VBO);
+		glDeleteBuffers(1, &EBO);
+		VBO = EBO = VAO = 0;
+		vertexRanges.reset(0);
+		indexRanges.reset(0);
+	}
+};
+
+#endif
@@ -0,0 +1,157 @@
+#ifndef GL_STATE_H
+#define GL_STATE_H
+
+#include <glad/glad.h>
+
+/* Thin cache in front of the OpenGL state :
+* remembers the bound program, VAO, textures per unit and the depth/blend state,
+* and skips the calls that would not change anything.
+* Every change of this state must go through it (or be followed by invalidate()).
+*/
+class GLStateCache
+{
+public:
+	static const int maxTextureUnits = 16;
+
+	//calls sent to the driver / skipped, for the current frame and the previous one
+	unsigned int issued = 0;
+	unsigned int elided = 0;
+	unsigned int lastFrameIssued = 0;
+	unsigned int lastFrameElided = 0;
+
+	GLStateCache() {
+		invalidate();
+	}
+
+	void useProgram(GLuint program) {
+		if (count(program == currentProgram)) return;
+		currentProgram = program;
+		glUseProgram(program);
+	}
+
+	void bindVertexArray(GLuint vao) {
+		if (count(vao == currentVAO)) return;
+		currentVAO = vao;
+		glBindVertexArray(vao);
+	}
+
+	void activeTexture(GLenum unit) {
+		if (count(unit == currentUnit)) return;
+		currentUnit = unit;
+		glActiveTexture(unit);
+	}
+
+	//bind on the active unit
+	void bindTexture(GLenum target, GLuint texture) {
+		GLuint* bound = boundTexture(target);
+		if (count(bound && *bound == texture)) return;
+		if (bound) *bound = texture;
+		glBindTexture(target, texture);
+	}
+
+	//bind on a given unit, changing the active unit only if needed
+	void bindTexture(GLenum unit, GLenum target, GLuint texture) {
+		GLuint* bound = boundTexture(unit, target);
+		if (bound && *bound == texture) {
+			elided++;
+			return;
+		}
+		activeTexture(unit);
+		bindTexture(target, texture);
+	}
+
+	void depthFunc(GLenum func) {
+		if (count(func == currentDepthFunc)) return;
+		currentDepthFunc = func;
+		glDepthFunc(func);
+	}
+
+	void blendFunc(GLenum src, GLenum dst) {
+		if (count(src == currentBlendSrc && dst == currentBlendDst)) return;
+		currentBlendSrc = src;
+		currentBlendDst = dst;
+		glBlendFunc(src, dst);
+	}
+
+	//glEnable / glDisable for the capabilities that are tracked (others are always sent)
+	void setCapability(GLenum cap, bool enabled) {
+		int* state = capability(cap);
+		if (count(state && *state == (int)enabled)) return;
+		if (state) *state = enabled;
+		if (enabled) glEnable(cap);
+		else glDisable(cap);
+	}
+
+	void enable(GLenum cap) { setCapability(cap, true); }
+	void disable(GLenum cap) { setCapability(cap, false); }
+
+	//forget everything, the next calls are all sent (after code that changed the state behind the cache)
+	void invalidate() {
+		currentProgram = unknown;
+		currentVAO = unknown;
+		currentUnit = unknown;
+		for (int i = 0; i < maxTextureUnits; i++) {
+			textures2D[i] = unknown;
+			texturesCube[i] = unknown;
+		}
+		currentDepthFunc = unknown;
+		currentBlendSrc = currentBlendDst = unknown;
+		depthTest = blend = cullFace = -1;
+	}
+
+	//to call once per frame : keeps the counters of the frame that ends
+	void endFrame() {
+		lastFrameIssued = issued;
+		lastFrameElided = elided;
+		issued = 0;
+		elided = 0;
+	}
+
+private:
+	static const GLuint unknown = 0xFFFFFFFFu;
+
+	GLuint currentProgram, currentVAO;
+	GLenum currentUnit;
+	GLuint textures2D[maxTextureUnits];
+	GLuint texturesCube[maxTextureUnits];
+	GLenum currentDepthFunc, currentBlendSrc, currentBlendDst;
+	//-1 unknown, 0 disabled, 1 enabled
+	int depthTest, blend, cullFace;
+
+	//returns true (and counts an elided call) when the call can be skipped
+	bool count(bool redundant) {
+		if (redundant) elided++;
+		else issued++;
+		return redundant;
+	}
+
+	GLuint* boundTexture(GLenum unit, GLenum target) {
+		int index = (int)unit - GL_TEXTURE0;
+		if (index < 0 || index >= maxTextureUnits) return nullptr;
+		if (target == GL_TEXTURE_2D) return &textures2D[index];
+		if (target == GL_TEXTURE_CUBE_MAP) return &texturesCube[index];
+		return nullptr;
+	}
+
+	GLuint* boundTexture(GLenum target) {
+		if (currentUnit == unknown) return nullptr;
+		return boundTexture(currentUnit, target);
+	}
+
+	int* capability(GLenum cap) {
+		switch (cap) {
+		case GL_DEPTH_TEST: return &depthTest;
+		case GL_BLEND: return &blend;
+		case GL_CULL_FACE: return &cullFace;
+		default: return nullptr;
+		}
+	}
+};
+
+//the cache of the current context
+inline GLStateCache& glState() {
+	static GLStateCache state;
+	return state;
+}
+
+#endif
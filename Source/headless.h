@@ -0,0 +1,119 @@
+#ifndef HEADLESS_H
+#define HEADLESS_H
+
+#include<iostream>
+
+#include <glad/glad.h>
+
+#ifdef HEADLESS_EGL
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+#endif
+
+/* Headless rendering (--headless) : no window, the frames are drawn into an offscreen framebuffer.
+* The context comes from EGL without any surface (Mesa llvmpipe on a CPU-only box) when the build found EGL,
+* otherwise from the GLFW null platform with OSMesa (see main).
+*/
+
+//color + depth renderbuffers, the frames are drawn here instead of the default framebuffer
+class OffscreenTarget
+{
+public:
+	GLuint FBO = 0;
+	int width, height;
+
+	OffscreenTarget(int width, int height) : width(width), height(height) {
+		glGenFramebuffers(1, &FBO);
+		glGenRenderbuffers(2, renderbuffers);
+
+		glBindRenderbuffer(GL_RENDERBUFFER, renderbuffers[0]);
+		glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, width, height);
+		glBindRenderbuffer(GL_RENDERBUFFER, renderbuffers[1]);
+		glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH24_STENCIL8, width, height);
+		glBindRenderbuffer(GL_RENDERBUFFER, 0);
+
+		glBindFramebuffer(GL_FRAMEBUFFER, FBO);
+		glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, renderbuffers[0]);
+		glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT, GL_RENDERBUFFER, renderbuffers[1]);
+		if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
+			std::cout << "Offscreen framebuffer is not complete" << std::endl;
+		}
+		glBindFramebuffer(GL_FRAMEBUFFER, 0);
+	}
+
+	OffscreenTarget(const OffscreenTarget&) = delete;
+	OffscreenTarget& operator=(const OffscreenTarget&) = delete;
+
+	~OffscreenTarget() {
+		glDeleteFramebuffers(1, &FBO);
+		glDeleteRenderbuffers(2, renderbuffers);
+	}
+
+	void bind() {
+		glBindFramebuffer(GL_FRAMEBUFFER, FBO);
+		glViewport(0, 0, width, height);
+	}
+
+private:
+	GLuint renderbuffers[2];
+};
+
+
+#ifdef HEADLESS_EGL
+//OpenGL core context on the surfaceless Mesa platform (EGL_MESA_platform_surfaceless)
+class EGLHeadlessContext
+{
+public:
+	~EGLHeadlessContext() {
+		destroy();
+	}
+
+	bool create(int major, int minor, bool debug) {
+		PFNEGLGETPLATFORMDISPLAYEXTPROC getPlatformDisplay = (PFNEGLGETPLATFORMDISPLAYEXTPROC)eglGetProcAddress("eglGetPlatformDisplayEXT");
+		if (!getPlatformDisplay) return false;
+		display = getPlatformDisplay(EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, nullptr);
+		if (display == EGL_NO_DISPLAY || !eglInitialize(display, nullptr, nullptr)) {
+			display = EGL_NO_DISPLAY;
+			return false;
+		}
+		if (!eglBindAPI(EGL_OPENGL_API)) {
+			destroy();
+			return false;
+		}
+
+		const EGLint attributes[] = {
+			EGL_CONTEXT_MAJOR_VERSION, major,
+			EGL_CONTEXT_MINOR_VERSION, minor,
+			EGL_CONTEXT_OPENGL_PROFILE_MASK, EGL_CONTEXT_OPENGL_CORE_PROFILE_BIT,
+			EGL_CONTEXT_OPENGL_DEBUG, debug ? EGL_TRUE : EGL_FALSE,
+			EGL_NONE
+		};
+		//no config : the context is only used with framebuffer objects
+		context = eglCreateContext(display, EGL_NO_CONFIG_KHR, EGL_NO_CONTEXT, attributes);
+		if (context == EGL_NO_CONTEXT || !eglMakeCurrent(display, EGL_NO_SURFACE, EGL_NO_SURFACE, context)) {
+			destroy();
+			return false;
+		}
+		return true;
+	}
+
+	void destroy() {
+		if (display == EGL_NO_DISPLAY) return;
+		eglMakeCurrent(display, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+		if (context != EGL_NO_CONTEXT) eglDestroyContext(display, context);
+		eglTerminate(display);
+		context = EGL_NO_CONTEXT;
+		display = EGL_NO_DISPLAY;
+	}
+
+	static void* getProcAddress(const char* name) {
+		return (void*)eglGetProcAddress(name);
+	}
+
+private:
+	EGLDisplay display = EGL_NO_DISPLAY;
+	EGLContext context = EGL_NO_CONTEXT;
+};
+#endif
+
+#endif
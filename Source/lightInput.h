@@ -8,14 +8,17 @@
 #include <sstream>
 #include <iostream>
 
+#include "frameData.h"
+
 class LightInput
 {
 public:
 	//reflection object
 
 	const std::string reflV = "#version 330 core\n"
+		+ frameDataGLSL +
 		"in vec3 position; \n"
-		"in vec2 tex_coords; \n"
+		"in vec2 tex_coord; \n"
 		"in vec3 normal; \n"
 
 		"out vec3 v_frag_coord; \n"
@@ -23,8 +26,6 @@ public:
 
 		"uniform mat4 M; \n"
 		"uniform mat4 itM; \n"
-		"uniform mat4 V; \n"
-		"uniform mat4 P; \n"
 
 
 		" void main(){ \n"
@@ -36,13 +37,13 @@ public:
 		"}\n";
 
 	const std::string reflF = "#version 400 core\n"
+		+ frameDataGLSL +
 		"out vec4 FragColor;\n"
 		"precision mediump float; \n"
 
 		"in vec3 v_frag_coord; \n"
 		"in vec3 v_normal; \n"
 
-		"uniform vec3 u_view_pos; \n"
 
 		"uniform samplerCube cubemapSampler; \n"
 
@@ -56,8 +57,9 @@ public:
 
 	// for refraction
 	const std::string refrV = "#version 330 core\n"
+		+ frameDataGLSL +
 		"in vec3 position; \n"
-		"in vec2 tex_coords; \n"
+		"in vec2 tex_coord; \n"
 		"in vec3 normal; \n"
 
 		"out vec3 v_frag_coord; \n"
@@ -66,8 +68,6 @@ public:
 
 		"uniform mat4 M; \n"
 		"uniform mat4 itM; \n"
-		"uniform mat4 V; \n"
-		"uniform mat4 P; \n"
 
 
 		" void main(){ \n"
@@ -79,13 +79,13 @@ public:
 		"}\n";
 
 	const std::string refrF = "#version 400 core\n"
+		+ frameDataGLSL +
 		"out vec4 FragColor;\n"
 		"precision mediump float; \n"
 
 		"in vec3 v_frag_coord; \n"
 		"in vec3 v_normal; \n"
 
-		"uniform vec3 u_view_pos; \n"
 
 		"uniform samplerCube cubemapSampler; \n"
 		"uniform float refractionIndice;\n"
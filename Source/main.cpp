@@ -7,17 +7,45 @@
 #include<glm/gtc/matrix_transform.hpp>
 #include<glm/gtc/type_ptr.hpp>
 #include<glm/gtc/matrix_inverse.hpp>
+#include<glm/gtc/constants.hpp>
+#include<glm/gtc/quaternion.hpp>
 
 #include <map>
-
-#define STB_IMAGE_IMPLEMENTATION
-#include "stb_image.h"
+#include <vector>
+#include <string>
+#include <random>
+#include <memory>
+#include <chrono>
+#include <thread>
+#include <algorithm>
+#include <functional>
+#include <cmath>
 
 #include "camera.h"
 #include "shader.h"
 #include "object.h"
 #include "shaderInput.h"
 #include "lightInput.h"
+#include "frameData.h"
+#include "glState.h"
+#include "profiler.h"
+#include "headless.h"
+#include "textureLoader.h"
+#include "textureStreamer.h"
+#include "textureFile.h"
+#include "frustum.h"
+#include "sceneGraph.h"
+#include "transformStore.h"
+#include "simClock.h"
+#include "nbody.h"
+
+//after the headers using stb, which include the declarations only
+#define STB_IMAGE_IMPLEMENTATION
+#include "stb_image.h"
+#define STB_DXT_IMPLEMENTATION
+#include "stb_dxt.h"
+#define STB_IMAGE_RESIZE_IMPLEMENTATION
+#include "stb_image_resize.h"
 
 
 const int width = 1000;
@@ -28,10 +56,12 @@ LightInput lightInput;
 
 GLuint compileShader(std::string shaderCode, GLenum shaderType);
 GLuint compileProgram(GLuint vertexShader, GLuint fragmentShader);
-void processInput(GLFWwindow* window);
-void loadCubemapFace(const char* file, const GLenum& targetCube);
+void processInput(GLFWwindow* window, float deltaTime);
+void defineCubemap(GLuint& texture, const std::map<std::string, GLenum>& faces, TextureLoader& loader, TextureStreamer& streamer);
 
-void defineTexture(GLuint& texture, const char* path);
+void defineTexture(GLuint& texture, const char* path, TextureLoader& loader, TextureStreamer& streamer);
+std::vector<std::string> cubemapSources(const std::map<std::string, GLenum>& faces);
+std::string cubemapFilePath(const std::map<std::string, GLenum>& faces);
 
 
 #ifndef NDEBUG
@@ -85,41 +115,350 @@ void APIENTRY glDebugOutput(GLenum source,
 
 Camera camera(glm::vec3(1.0, 0.0, -6.0), glm::vec3(0.0, 1.0, 0.0), 90.0);
 
+//command line options
+struct Options {
+	//--bake-meshes [file.obj ...] : write the binary mesh caches and exit
+	bool bakeMeshes = false;
+	std::vector<std::string> meshesToBake;
+	//--bake-textures [image ...] : write the compressed textures (with their mipmaps) and exit
+	bool bakeTextures = false;
+	std::vector<std::string> texturesToBake;
+	//--asteroids N : add a belt of N small spheres around the earth
+	int asteroids = 0;
+	//--no-instancing : draw the belt with one draw call per asteroid (for comparison)
+	bool instancing = true;
+	//--no-culling : draw every object, even outside the view (for comparison)
+	bool culling = true;
+	//--bunnies N : add a field of N bunnies behind the earth
+	int bunnies = 0;
+	//--no-lod : draw every object at full detail (for comparison)
+	bool lod = true;
+	//--quantize : 16 byte packed vertices instead of 32 bytes of floats (except the skybox)
+	bool quantize = false;
+	//--no-pool : every mesh in its own buffers, with its own VAO (for comparison)
+	bool pool = true;
+	//--profile-csv file / --profile-trace file : write the frame profile at exit (the trace opens in chrome://tracing)
+	std::string profileCSV;
+	std::string profileTrace;
+	//--headless [--frames N] : no window, render N frames offscreen without vsync and print the frame times
+	bool headless = false;
+	int frames = 600;
+	//--sync-textures : decode the textures on the main thread before the first frame (for comparison)
+	bool asyncTextures = true;
+	//--upload-budget KB : texture bytes sent to the GPU per frame
+	size_t uploadBudget = 4096 * 1024;
+	//--sim-rate HZ : simulation steps per second, independent of the frame rate
+	double simRate = 60.0;
+	//--bench-uniforms : time the M / itM uploads of --frames frames, by name and by location, then exit
+	bool benchUniforms = false;
+};
+
+Options parseOptions(int argc, char* argv[]) {
+	Options options;
+	for (int i = 1; i < argc; i++) {
+		std::string arg = argv[i];
+		if (arg == "--bake-meshes") {
+			options.bakeMeshes = true;
+			while (i + 1 < argc && argv[i + 1][0] != '-') {
+				options.meshesToBake.push_back(argv[++i]);
+			}
+		}
+		else if (arg == "--bake-textures") {
+			options.bakeTextures = true;
+			while (i + 1 < argc && argv[i + 1][0] != '-') {
+				options.texturesToBake.push_back(argv[++i]);
+			}
+		}
+		else if (arg == "--asteroids" && i + 1 < argc) {
+			options.asteroids = std::atoi(argv[++i]);
+		}
+		else if (arg == "--no-instancing") {
+			options.instancing = false;
+		}
+		else if (arg == "--no-culling") {
+			options.culling = false;
+		}
+		else if (arg == "--bunnies" && i + 1 < argc) {
+			options.bunnies = std::atoi(argv[++i]);
+		}
+		else if (arg == "--no-lod") {
+			options.lod = false;
+		}
+		else if (arg == "--quantize") {
+			options.quantize = true;
+		}
+		else if (arg == "--no-pool") {
+			options.pool = false;
+		}
+		else if (arg == "--profile-csv" && i + 1 < argc) {
+			options.profileCSV = argv[++i];
+		}
+		else if (arg == "--profile-trace" && i + 1 < argc) {
+			options.profileTrace = argv[++i];
+		}
+		else if (arg == "--headless") {
+			options.headless = true;
+		}
+		else if (arg == "--frames" && i + 1 < argc) {
+			options.frames = std::atoi(argv[++i]);
+		}
+		else if (arg == "--sync-textures") {
+			options.asyncTextures = false;
+		}
+		else if (arg == "--upload-budget" && i + 1 < argc) {
+			options.uploadBudget = (size_t)std::atol(argv[++i]) * 1024;
+		}
+		else if (arg == "--sim-rate" && i + 1 < argc) {
+			options.simRate = std::max(1.0, std::atof(argv[++i]));
+		}
+		else if (arg == "--bench-uniforms") {
+			options.benchUniforms = true;
+		}
+		else {
+			std::cout << "Unknown option " << arg << std::endl;
+		}
+	}
+	return options;
+}
+
+//the six images of the skybox and their face of the cubemap
+std::map<std::string, GLenum> skyboxFaces() {
+	std::string pathToCubeMap = PATH_TO_TEXTURE "/cubemaps/space/";
+
+	std::map<std::string, GLenum> facesToLoad = {
+		{pathToCubeMap + "space1.png",GL_TEXTURE_CUBE_MAP_POSITIVE_X},
+		{pathToCubeMap + "space5.png",GL_TEXTURE_CUBE_MAP_POSITIVE_Y},
+		{pathToCubeMap + "space2.png",GL_TEXTURE_CUBE_MAP_POSITIVE_Z},
+		{pathToCubeMap + "space3.png",GL_TEXTURE_CUBE_MAP_NEGATIVE_X},
+		{pathToCubeMap + "space6.png",GL_TEXTURE_CUBE_MAP_NEGATIVE_Y},
+		{pathToCubeMap + "space4.png",GL_TEXTURE_CUBE_MAP_NEGATIVE_Z},
+	};
+	return facesToLoad;
+}
+
+//animated angles of the scene (degrees), advanced by the fixed simulation steps, and the bodies of the gravity simulation
+struct SceneState {
+	double earthSpin = 0.0;
+	double alienSpin = 0.0;
+	double alien2Orbit = 0.0;
+	glm::vec3 earth = glm::vec3(0.0);
+	glm::vec3 moon = glm::vec3(0.0);
+
+	//degrees per second
+	void step(double seconds) {
+		earthSpin += 30.0 * seconds;
+		alienSpin += 180.0 * seconds;
+		alien2Orbit += 120.0 * seconds;
+	}
+
+	//state shown by a frame between two steps
+	static SceneState interpolate(const SceneState& a, const SceneState& b, double alpha) {
+		SceneState state;
+		state.earthSpin = glm::mix(a.earthSpin, b.earthSpin, alpha);
+		state.alienSpin = glm::mix(a.alienSpin, b.alienSpin, alpha);
+		state.alien2Orbit = glm::mix(a.alien2Orbit, b.alien2Orbit, alpha);
+		state.earth = glm::mix(a.earth, b.earth, (float)alpha);
+		state.moon = glm::mix(a.moon, b.moon, (float)alpha);
+		return state;
+	}
+};
+
+//rotation of `degrees` around axis (the angle is wrapped first, it grows without bound)
+glm::quat rotationDegrees(double degrees, glm::vec3 axis) {
+	return glm::angleAxis(glm::radians((float)std::fmod(degrees, 360.0)), glm::normalize(axis));
+}
+
+//one asteroid : a circular orbit in the plane of the belt and a spin around its own axis
+struct AsteroidOrbit {
+	float radius, height, phase;
+	//degrees per second
+	float orbitSpeed, spinSpeed;
+	glm::vec3 axis;
+};
+
+/* Earth and moon as two bodies of the gravity simulation : the moon starts at offset from the earth on a circular orbit
+* around axis lasting period seconds, the barycenter stays at center. The masses have the real ratio (81 : 1),
+* their sum comes from the period (Kepler, G = 1) : the earth wobbles a little around the barycenter.
+*/
+void addEarthMoon(NBodySystem& bodies, glm::vec3 center, glm::vec3 offset, glm::vec3 axis, float period, size_t& earth, size_t& moon) {
+	float r = glm::length(offset);
+	float total = 4.0f * glm::pi<float>() * glm::pi<float>() * r * r * r / (bodies.G * period * period);
+	float moonShare = 1.0f / 82.0f;
+	glm::vec3 velocity = std::sqrt(bodies.G * total / r) * glm::normalize(glm::cross(glm::normalize(axis), offset));
+	earth = bodies.add(center - moonShare * offset, -moonShare * velocity, (1.0f - moonShare) * total);
+	moon = bodies.add(center + (1.0f - moonShare) * offset, (1.0f - moonShare) * velocity, moonShare * total);
+}
+
+//random but reproducible asteroids in a flat ring, the inner ones turn faster (Kepler), their scale is in transforms
+std::vector<AsteroidOrbit> makeAsteroidBelt(int count, TransformStore& transforms) {
+	std::mt19937 random(502);
+	std::uniform_real_distribution<float> angle(0.0f, glm::two_pi<float>());
+	std::uniform_real_distribution<float> radius(2.5f, 4.5f);
+	std::uniform_real_distribution<float> height(-0.15f, 0.15f);
+	std::uniform_real_distribution<float> scale(0.01f, 0.04f);
+	std::uniform_real_distribution<float> axis(-1.0f, 1.0f);
+	std::uniform_real_distribution<float> spin(30.0f, 180.0f);
+
+	std::vector<AsteroidOrbit> belt(count);
+	for (int i = 0; i < count; i++) {
+		AsteroidOrbit& orbit = belt[i];
+		orbit.radius = radius(random);
+		orbit.height = height(random);
+		orbit.phase = angle(random);
+		orbit.orbitSpeed = 12.0f * std::pow(2.5f / orbit.radius, 1.5f);
+		orbit.spinSpeed = spin(random);
+		orbit.axis = glm::normalize(glm::vec3(axis(random), axis(random), axis(random)) + glm::vec3(0.0, 0.0, 1e-3));
+		transforms.add(glm::vec3(0.0), glm::quat(1.0, 0.0, 0.0, 0.0), glm::vec3(scale(random)));
+	}
+	return belt;
+}
+
+/* Place the belt at a simulation time and rebuild all its matrices in one batch.
+* The orbits have a closed form : the belt is placed at the interpolated time of the frame, no state to step.
+*/
+void updateAsteroidBelt(const std::vector<AsteroidOrbit>& belt, glm::vec3 center, double time, TransformStore& transforms) {
+	for (size_t i = 0; i < belt.size(); i++) {
+		const AsteroidOrbit& orbit = belt[i];
+		float a = orbit.phase + glm::radians((float)std::fmod(orbit.orbitSpeed * time, 360.0));
+		transforms.setPosition(i, center + glm::vec3(orbit.radius * std::cos(a), orbit.height, orbit.radius * std::sin(a)));
+		transforms.setRotation(i, rotationDegrees(orbit.spinSpeed * time, orbit.axis));
+	}
+	transforms.update();
+}
+
+/* CPU time of the per-object uniforms (M and itM) of frames frames of objects objects, three ways :
+* glGetUniformLocation at each call (before the table of Shader), a lookup of the name in the table (setMatrix4("M")),
+* and the locations resolved once (the render loop). Nothing is drawn : only the cost of reaching the uniform is compared.
+*/
+void benchUniforms(Shader& shader, int objects, int frames) {
+	shader.use();
+	const glm::mat4 matrix = glm::translate(glm::mat4(1.0), glm::vec3(1.0, 2.0, 3.0));
+	const GLint M = shader.uniform("M");
+	const GLint itM = shader.uniform("itM");
+	auto time = [&](const char* name, const std::function<void()>& setUniforms) {
+		glFinish();
+		auto start = std::chrono::steady_clock::now();
+		for (int frame = 0; frame < frames; frame++) {
+			for (int object = 0; object < objects; object++) setUniforms();
+		}
+		double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+		glFinish();
+		std::cout << name << " : " << ms / frames << " ms per frame, " << 1e6 * ms / ((double)frames * objects * 2) << " ns per uniform" << std::endl;
+	};
+	std::cout << "Uniforms : " << frames << " frames of " << objects << " objects (M and itM)" << std::endl;
+	time("  glGetUniformLocation", [&]() {
+		glUniformMatrix4fv(glGetUniformLocation(shader.ID, "M"), 1, GL_FALSE, glm::value_ptr(matrix));
+		glUniformMatrix4fv(glGetUniformLocation(shader.ID, "itM"), 1, GL_FALSE, glm::value_ptr(matrix));
+	});
+	time("  name in the table", [&]() {
+		shader.setMatrix4("M", matrix);
+		shader.setMatrix4("itM", matrix);
+	});
+	time("  location", [&]() {
+		shader.setMatrix4(M, matrix);
+		shader.setMatrix4(itM, matrix);
+	});
+}
+
 
 int main(int argc, char* argv[])
 {
+	Options options = parseOptions(argc, argv);
+	//startup time, up to the first frame
+	auto startup = std::chrono::steady_clock::now();
+
+	if (options.bakeMeshes) {
+		if (options.meshesToBake.empty()) {
+			options.meshesToBake = { PATH_TO_OBJECTS "/sphere_smooth.obj", PATH_TO_OBJECTS "/bunny_small.obj", PATH_TO_OBJECTS "/cube.obj" };
+		}
+		for (const std::string& path : options.meshesToBake) {
+			Object::bakeCache(path.c_str());
+		}
+	}
+	if (options.bakeTextures) {
+		//2D textures are flipped as at load time
+		if (options.texturesToBake.empty()) {
+			options.texturesToBake = { PATH_TO_TEXTURE "/earth.jpg" };
+			bakeTexture(cubemapSources(skyboxFaces()), cubemapFilePath(skyboxFaces()).c_str(), false);
+		}
+		for (const std::string& path : options.texturesToBake) {
+			bakeTexture({ path }, textureFilePath(path).c_str(), true);
+		}
+	}
+	if (options.bakeMeshes || options.bakeTextures) {
+		return 0;
+	}
+
 	//Boilerplate
 	//Create the OpenGL context 
+	//destroyed last : the objects below free their buffers while the context still exists
+	struct ContextGuard {
+		GLFWwindow* window = nullptr;
+#ifdef HEADLESS_EGL
+		EGLHeadlessContext egl;
+#endif
+		~ContextGuard() {
+			if (window) glfwDestroyWindow(window);
+			glfwTerminate();
+		}
+	} context;
+
+	//headless : the null platform needs no display (GLFW still gives the timer)
+	if (options.headless) {
+		glfwInitHint(GLFW_PLATFORM, GLFW_PLATFORM_NULL);
+	}
 	if (!glfwInit()) {
 		throw std::runtime_error("Failed to initialise GLFW \n");
 	}
 	glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 4);
-	glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 0);
+	//4.3 : vertex attribute formats apart from the buffers (see vertexLayout.h)
+	glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
 	glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
 
+	bool debugContext = false;
 #ifndef NDEBUG
 	//create a debug context to help with Debugging
 	glfwWindowHint(GLFW_OPENGL_DEBUG_CONTEXT, true);
+	debugContext = true;
 #endif
 
-
-	//Create the window
-	GLFWwindow* window = glfwCreateWindow(width, height, "Project", nullptr, nullptr);
-	if (window == NULL)
-	{
-		glfwTerminate();
-		throw std::runtime_error("Failed to create GLFW window\n");
+	GLFWwindow* window = nullptr;
+	GLADloadproc getProcAddress = (GLADloadproc)glfwGetProcAddress;
+#ifdef HEADLESS_EGL
+	if (options.headless && context.egl.create(4, 3, debugContext)) {
+		getProcAddress = (GLADloadproc)EGLHeadlessContext::getProcAddress;
+		std::cout << "Headless rendering with an EGL surfaceless context" << std::endl;
 	}
+	else
+#endif
+	{
+		if (options.headless) {
+			//no EGL : hidden window of the null platform, with an OSMesa context
+			glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+			glfwWindowHint(GLFW_CONTEXT_CREATION_API, GLFW_OSMESA_CONTEXT_API);
+			std::cout << "Headless rendering with an OSMesa context" << std::endl;
+		}
 
-	glfwMakeContextCurrent(window);
+		//Create the window
+		window = glfwCreateWindow(width, height, "Project", nullptr, nullptr);
+		if (window == NULL)
+		{
+			throw std::runtime_error("Failed to create GLFW window\n");
+		}
+
+		context.window = window;
+		glfwMakeContextCurrent(window);
+	}
 
 	//load openGL function
-	if (!gladLoadGLLoader((GLADloadproc)glfwGetProcAddress))
+	if (!gladLoadGLLoader(getProcAddress))
 	{
 		throw std::runtime_error("Failed to initialize GLAD");
 	}
 
-	glEnable(GL_DEPTH_TEST);
+	glState().enable(GL_DEPTH_TEST);
+	//the baked cubemap has mipmaps : filter across the faces, not per face
+	glState().enable(GL_TEXTURE_CUBE_MAP_SEAMLESS);
 
 #ifndef NDEBUG
 	int flags;
@@ -133,49 +472,83 @@ int main(int argc, char* argv[])
 	}
 #endif
 
-	//Create and load the textures
+	//Create and load the textures : decoded by the workers while the rest is set up,
+	//each one shows a placeholder until it is uploaded, a few rows per frame
+	TextureLoader textureLoader(options.asyncTextures ? std::max(1u, std::thread::hardware_concurrency()) : 0);
+	TextureStreamer textureStreamer(options.uploadBudget);
+
 	GLuint earth_t;
-	defineTexture(earth_t, "../../../../Source/textures/earth.jpg");
+	defineTexture(earth_t, PATH_TO_TEXTURE "/earth.jpg", textureLoader, textureStreamer);
 
 	GLuint moon_t;
-	defineTexture(moon_t, "../../../../Source/textures/moon.jpg");
+	defineTexture(moon_t, PATH_TO_TEXTURE "/moon.jpg", textureLoader, textureStreamer);
+
+	GLuint cubeMapTexture;
+	defineCubemap(cubeMapTexture, skyboxFaces(), textureLoader, textureStreamer);
 
 
 	//Sphere objects path
-	char path1[] = "../../../../Source/objects/sphere_smooth.obj";
+	char path1[] = PATH_TO_OBJECTS "/sphere_smooth.obj";
 
 	//path bunny
-	char path2[] = "../../../../Source/objects/bunny_small.obj";
+	char path2[] = PATH_TO_OBJECTS "/bunny_small.obj";
 
 	Shader earthShader = Shader(shaderInput.v_earth, shaderInput.f_earth);
 
-	Object moon1(path1);
-	moon1.makeObject(earthShader);
-	moon1.model = glm::translate(moon1.model, glm::vec3(1.0, 0.0, -3.0));
-	moon1.model = glm::scale(moon1.model, glm::vec3(0.2, 0.2, 0.2));
+	//the model matrices of these objects come from the scene graph (see below)
+	const VertexFormat meshFormat = options.quantize ? VertexFormat::Packed : VertexFormat::Float;
+	geometryPool(VertexFormat::Float).enabled = options.pool;
+	geometryPool(VertexFormat::Packed).enabled = options.pool;
+	Object moon1(path1, true, meshFormat);
+	moon1.makeObject();
 
-	Object planet(path1);
-	planet.makeObject(earthShader);
-	planet.model = glm::translate(planet.model, glm::vec3(1.0, 0.0, 0.0));
-	planet.model = glm::scale(planet.model, glm::vec3(1.5, 1.5, 1.5));
+	Object planet(path1, true, meshFormat);
+	planet.makeObject();
 
 	//Reflection
 	Shader reflShader = Shader(lightInput.reflV, lightInput.reflF);
 
-	Object alien(path2);
-	alien.makeObject(reflShader);
-	alien.model = glm::translate(alien.model, glm::vec3(0.0, 1.0, - 2.5));
-	alien.model = glm::scale(alien.model, glm::vec3(0.1, 0.1, 0.1));
+	Object alien(path2, true, meshFormat);
+	alien.makeObject();
 
 	//Refraction
 	Shader refrShader = Shader(lightInput.refrV, lightInput.refrF);
 
-	Object alien2(path1);
-	alien2.makeObject(refrShader);
-	alien2.model = glm::translate(alien2.model, glm::vec3(2.0, -1.0, -2.5));
-	alien2.model = glm::scale(alien2.model, glm::vec3(0.1, 0.1, 0.1));
+	Object alien2(path1, true, meshFormat);
+	alien2.makeObject();
+
+	//Asteroid belt : the same sphere mesh drawn many times, in one instanced draw call
+	Shader asteroidShader = Shader(shaderInput.v_earth_instanced, shaderInput.f_earth);
+
+	//the transforms of the belt are kept as structure of arrays and rebuilt every frame by one batch (see TransformStore)
+	const glm::vec3 beltCenter = glm::vec3(1.0, 0.0, 0.0);
+	TransformStore asteroidTransforms;
+	std::vector<AsteroidOrbit> belt = makeAsteroidBelt(options.asteroids, asteroidTransforms);
+	updateAsteroidBelt(belt, beltCenter, 0.0, asteroidTransforms);
+	Object asteroid(path1, true, meshFormat);
+	//the bounding spheres move with the asteroids, their radius does not change
+	SphereSet asteroidSpheres;
+	for (size_t i = 0; i < belt.size(); i++) {
+		asteroidSpheres.push_back(transformSphere(asteroid.mesh->bounds, asteroidTransforms.world[i]));
+	}
+	if (options.asteroids > 0) {
+		asteroid.makeObject();
+		if (options.instancing) asteroid.makeInstances(asteroidTransforms.world);
+		std::cout << "Asteroid belt of " << options.asteroids << (options.instancing ? " instances" : " objects") << std::endl;
+	}
 
-	
+	//field of reflective bunnies, rows going away from the camera : most of them are far and use a coarse LOD
+	std::vector<std::unique_ptr<Object>> bunnies;
+	std::vector<glm::mat4> bunnyNormals;
+	int bunnyRow = (int)std::ceil(std::sqrt((double)options.bunnies));
+	for (int i = 0; i < options.bunnies; i++) {
+		bunnies.emplace_back(new Object(path2, true, meshFormat));
+		Object& bunny = *bunnies.back();
+		bunny.makeObject();
+		glm::vec3 position = glm::vec3(1.0 + 1.5 * (i % bunnyRow - 0.5 * (bunnyRow - 1)), -2.5, 4.0 + 1.5 * (i / bunnyRow));
+		bunny.model = glm::scale(glm::translate(glm::mat4(1.0), position), glm::vec3(0.2));
+		bunnyNormals.push_back(glm::inverseTranspose(bunny.model));
+	}
 
 	//CubeMap
 
@@ -183,57 +556,74 @@ int main(int argc, char* argv[])
 
 	char pathCube[] = PATH_TO_OBJECTS "/cube.obj";
 	Object cubeMap(pathCube);
-	cubeMap.makeObject(cubeMapShader);
-
-	GLuint cubeMapTexture;
-	glGenTextures(1, &cubeMapTexture);
-	glActiveTexture(GL_TEXTURE0);
-	glBindTexture(GL_TEXTURE_CUBE_MAP, cubeMapTexture);
+	cubeMap.makeObject();
 
-	// texture parameters
-	glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-	glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-	glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
-	glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-	glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-
-	stbi_set_flip_vertically_on_load(false);
-
-	std::string pathToCubeMap = PATH_TO_TEXTURE "/cubemaps/space/";
-
-	std::map<std::string, GLenum> facesToLoad = {
-		{pathToCubeMap + "space1.png",GL_TEXTURE_CUBE_MAP_POSITIVE_X},
-		{pathToCubeMap + "space5.png",GL_TEXTURE_CUBE_MAP_POSITIVE_Y},
-		{pathToCubeMap + "space2.png",GL_TEXTURE_CUBE_MAP_POSITIVE_Z},
-		{pathToCubeMap + "space3.png",GL_TEXTURE_CUBE_MAP_NEGATIVE_X},
-		{pathToCubeMap + "space6.png",GL_TEXTURE_CUBE_MAP_NEGATIVE_Y},
-		{pathToCubeMap + "space4.png",GL_TEXTURE_CUBE_MAP_NEGATIVE_Z},
-	};
-	//load the six faces
-	for (std::pair<std::string, GLenum> pair : facesToLoad) {
-		loadCubemapFace(pair.first.c_str(), pair.second);
-	}
 
 
 	const glm::vec3 light_pos = glm::vec3(-5.0, 0.0, -1.5);
 
+	/* Scene graph : the sun (the light) -> the earth -> the moon, and the two aliens.
+	* The earth spin is a node of its own : the moon follows the earth but not its rotation and scale.
+	* The positions of the earth and the moon come from the gravity simulation.
+	* The refractive sphere turns around a point next to it, as the moon turns around the earth.
+	*/
+	SceneGraph scene;
+	const glm::quat noRotation = glm::quat(1.0, 0.0, 0.0, 0.0);
+	const SceneGraph::NodeId sunNode = scene.addNode(SceneGraph::root, light_pos);
+	const SceneGraph::NodeId earthNode = scene.addNode(sunNode, glm::vec3(1.0, 0.0, 0.0) - light_pos);
+	const SceneGraph::NodeId earthSpinNode = scene.addNode(earthNode, glm::vec3(0.0), noRotation, glm::vec3(1.5));
+	const SceneGraph::NodeId moonNode = scene.addNode(earthNode, glm::vec3(0.0, 0.0, -3.0), noRotation, glm::vec3(0.2));
+	const SceneGraph::NodeId alienNode = scene.addNode(SceneGraph::root, glm::vec3(0.0, 1.0, -2.5), noRotation, glm::vec3(0.1));
+	const SceneGraph::NodeId alien2OrbitNode = scene.addNode(SceneGraph::root, glm::vec3(2.1, -1.0, -2.4));
+	const SceneGraph::NodeId alien2Node = scene.addNode(alien2OrbitNode, glm::vec3(-0.1, 0.0, -0.1), noRotation, glm::vec3(0.1));
+	int sceneUpdates = 0;
+
+
+	//frustum culling : objects drawn and skipped, this frame and since the start
+	Frustum frustum;
+	int drawnObjects = 0, culledObjects = 0;
+	long long totalDrawn = 0, totalCulled = 0;
+	//level of detail : triangles submitted, this frame and since the start, and what full detail would have drawn
+	//pixels covered by one unit at distance 1, set with the projection
+	float lodPixelScale = 1.0f;
+	long long drawnTriangles = 0, fullTriangles = 0;
+	long long totalTriangles = 0, totalFullTriangles = 0;
+	auto isVisible = [&](Object& object) {
+		bool visible = !options.culling || object.isVisible(frustum);
+		(visible ? drawnObjects : culledObjects)++;
+		if (visible) {
+			if (options.lod) object.selectLod(camera.Position, lodPixelScale);
+			drawnTriangles += object.triangles();
+			fullTriangles += object.mesh->lods[0].indexCount / 3;
+		}
+		return visible;
+	};
+	//visible asteroids
+	std::vector<uint8_t> asteroidVisible;
+	std::vector<InstanceData> visibleInstances;
 
 	double prev = 0;
 	int deltaFrame = 0;
-	//fps function
-	auto fps = [&](double now) {
+	double cpuFrameTime = 0.0;
+	//fps function, also reports the CPU time spent per frame to record the commands
+	auto fps = [&](double now, double cpuTime) {
 		double deltaTime = now - prev;
 		deltaFrame++;
+		cpuFrameTime += cpuTime;
 		if (deltaTime > 0.5) {
 			prev = now;
 			const double fpsCount = (double)deltaFrame / deltaTime;
+			std::cout << "\r FPS: " << fpsCount << " CPU: " << 1000.0 * cpuFrameTime / deltaFrame << " ms/frame"
+				<< " GL state calls: " << glState().lastFrameIssued << " issued " << glState().lastFrameElided << " elided"
+				<< " objects: " << drawnObjects << " drawn " << culledObjects << " culled ";
 			deltaFrame = 0;
-			std::cout << "\r FPS: " << fpsCount;
+			cpuFrameTime = 0.0;
 		}
 	};
 
 	glm::mat4 view = camera.GetViewMatrix();
 	glm::mat4 perspective = camera.GetProjectionMatrix();
+	lodPixelScale = perspective[1][1] * height / 2.0f;
 
 	glm::vec3 materialColour = glm::vec3(0.0, 1.0, 0.0);
 
@@ -248,202 +638,523 @@ int main(int argc, char* argv[])
 
 	refrShader.use();
 	refrShader.setFloat("refractionIndice", 1.52);
+	refrShader.setInteger("cubemapSampler", 0);
 
-	earthShader.use();
+	reflShader.use();
+	reflShader.setInteger("cubemapSampler", 0);
+
+	cubeMapShader.use();
+	cubeMapShader.setInteger("cubemapSampler", 0);
 
+	earthShader.use();
+	earthShader.setInteger("textureSampler", 0);
 	earthShader.setFloat("shininess", 32.0f);
-	earthShader.setFloat("light.ambient_strength", ambient);
-	earthShader.setFloat("light.diffuse_strength", diffuse);
-	earthShader.setFloat("light.specular_strength", specular);
-	earthShader.setFloat("light.constant", 0.5);
-	earthShader.setFloat("light.linear", 0.40);
-	earthShader.setFloat("light.quadratic", 0.03);
 
-	
+	asteroidShader.use();
+	asteroidShader.setInteger("textureSampler", 0);
+	asteroidShader.setFloat("shininess", 32.0f);
+
+	//camera and light are shared by all the programs through one uniform buffer
+	FrameUniforms frameUniforms;
+	frameUniforms.attach(earthShader);
+	frameUniforms.attach(reflShader);
+	frameUniforms.attach(refrShader);
+	frameUniforms.attach(cubeMapShader);
+	frameUniforms.attach(asteroidShader);
+
+	frameUniforms.data.P = perspective;
+	frameUniforms.data.lightPos = light_pos;
+	frameUniforms.data.ambientStrength = ambient;
+	frameUniforms.data.diffuseStrength = diffuse;
+	frameUniforms.data.specularStrength = specular;
+	frameUniforms.data.constant = 0.5;
+	frameUniforms.data.linear = 0.40;
+	frameUniforms.data.quadratic = 0.03;
+
+	//uniform locations used every frame, resolved once
+	const GLint earthM = earthShader.uniform("M");
+	const GLint earthItM = earthShader.uniform("itM");
+
+	const GLint reflM = reflShader.uniform("M");
+	const GLint reflItM = reflShader.uniform("itM");
+
+	const GLint refrM = refrShader.uniform("M");
+	const GLint refrItM = refrShader.uniform("itM");
+
+	//the objects drawn one by one : planet, moon, the two aliens, the bunnies and the asteroids without instancing
+	if (options.benchUniforms) {
+		benchUniforms(earthShader, 4 + options.bunnies + (options.instancing ? 0 : options.asteroids), options.frames);
+		return 0;
+	}
 
 
-	glfwSwapInterval(1);
+	//per-pass CPU and GPU timings
+	Profiler profiler;
+	const int planetZone = profiler.zone("planet");
+	const int moonZone = profiler.zone("moon");
+	const int asteroidsZone = profiler.zone("asteroids");
+	const int reflectiveZone = profiler.zone("reflective");
+	const int refractiveZone = profiler.zone("refractive");
+	const int skyboxZone = profiler.zone("skybox");
+	const int uploadZone = profiler.zone("texture upload");
+
+	//headless : draw in an offscreen framebuffer, as fast as possible
+	std::unique_ptr<OffscreenTarget> offscreen;
+	if (options.headless) {
+		offscreen.reset(new OffscreenTarget(width, height));
+		offscreen->bind();
+	}
+	if (window) {
+		glfwSwapInterval(options.headless ? 0 : 1);
+	}
 
-	while (!glfwWindowShouldClose(window)) {
-		processInput(window);
+	//simulation : fixed steps, the frames interpolate between the last two states
+	SimClock simClock(1.0 / options.simRate);
+	SceneState previousState, state;
+
+	//gravity : the moon around the earth in 2 s, as the animation it replaces, stepped with the simulation
+	const glm::vec3 moonOffset = glm::vec3(0.0, 0.0, -3.0);
+	NBodySystem bodies;
+	size_t earthBody, moonBody;
+	addEarthMoon(bodies, glm::vec3(1.0, 0.0, 0.0), moonOffset, glm::vec3(0.5, 1.0, 0.0), 2.0f, earthBody, moonBody);
+	const double initialEnergy = bodies.energy();
+	state.earth = bodies.position(earthBody);
+	state.moon = bodies.position(moonBody);
+	previousState = state;
+	//headless : every frame lasts 1/60 s of scene time, the frames show the same scene at any frame rate
+	const double headlessFrameTime = 1.0 / 60.0;
+
+	int frame = 0;
+	bool texturesLoading = true;
+	double startTime = glfwGetTime();
+
+	while (options.headless ? frame < options.frames : !glfwWindowShouldClose(window)) {
+		profiler.beginFrame();
+		double cpuStart = glfwGetTime();
+		//queue the textures decoded since the last frame, and send this frame's share of the uploads
+		profiler.begin(uploadZone);
+		textureLoader.poll();
+		textureStreamer.update();
+		profiler.end(uploadZone);
+		double now = glfwGetTime();
+		int steps = simClock.advance(options.headless ? frame * headlessFrameTime : now);
+		for (int i = 0; i < steps; i++) {
+			previousState = state;
+			state.step(simClock.step);
+			bodies.step((float)simClock.step);
+			state.earth = bodies.position(earthBody);
+			state.moon = bodies.position(moonBody);
+		}
+		if (!options.headless) {
+			processInput(window, simClock.frameDuration());
+		}
 		view = camera.GetViewMatrix();
 		glfwPollEvents();
-		double now = glfwGetTime();
 		glClearColor(0.5f, 0.5f, 0.5f, 1.0f);
 		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
-
+		frameUniforms.data.V = view;
+		frameUniforms.data.viewPos = glm::vec4(camera.Position, 1.0);
+		frameUniforms.update();
+
+		//animation : the state between the last two steps, then the dirty nodes are recomputed
+		SceneState shown = SceneState::interpolate(previousState, state, simClock.alpha());
+		scene.setRotation(earthSpinNode, rotationDegrees(shown.earthSpin, glm::vec3(0.0, 1.0, 0.0)));
+		//the moon always shows the same face to the earth
+		scene.setPosition(earthNode, shown.earth - light_pos);
+		scene.setPosition(moonNode, shown.moon - shown.earth);
+		scene.setRotation(moonNode, glm::quat(glm::normalize(moonOffset), glm::normalize(shown.moon - shown.earth)));
+		scene.setRotation(alienNode, rotationDegrees(shown.alienSpin, glm::vec3(1.0, 0.0, 1.0)));
+		scene.setRotation(alien2OrbitNode, rotationDegrees(shown.alien2Orbit, glm::vec3(0.0, -1.0, 0.0)));
+		sceneUpdates += scene.update();
+		planet.model = scene.world(earthSpinNode);
+		moon1.model = scene.world(moonNode);
+		alien.model = scene.world(alienNode);
+		alien2.model = scene.world(alien2Node);
+
+		//the objects outside the view are skipped before their uniforms, they keep moving
+		frustum = Frustum(perspective * view);
+		drawnObjects = culledObjects = 0;
+		drawnTriangles = fullTriangles = 0;
+
+		profiler.begin(planetZone);
 		earthShader.use();
+		if (isVisible(planet)) {
+			earthShader.setMatrix4(earthM, planet.shaderModel());
+			earthShader.setMatrix4(earthItM, scene.inverseTranspose(earthSpinNode));
 
-		earthShader.setMatrix4("M", planet.model);
-		earthShader.setMatrix4("V", view);
-		earthShader.setMatrix4("P", perspective);
-		earthShader.setVector3f("u_view_pos", camera.Position);
-		//earthShader.setVector3f("u_light_pos", light_pos);
-		earthShader.setVector3f("light.light_pos", light_pos);
-
-		glm::mat4 itM = glm::inverseTranspose(planet.model);
-		earthShader.setMatrix4("itM", itM);
-
-		//earth rotation around itself
-		planet.model = glm::rotate(planet.model, glm::radians((float)(0.5f)), glm::vec3(0.0, 1.0, 0.0));
+			//earth texture
+			glState().bindTexture(GL_TEXTURE0, GL_TEXTURE_2D, earth_t);
 
-		//earth texture
-		glBindTexture(GL_TEXTURE_2D, earth_t);
-
-		planet.draw();
-
-		earthShader.use();
-
-		earthShader.setMatrix4("M", moon1.model);
-		earthShader.setMatrix4("V", view);
-		earthShader.setMatrix4("P", perspective);
-		earthShader.setVector3f("u_light_pos", light_pos);
-
-		earthShader.setMatrix4("M", moon1.model);
-		earthShader.setMatrix4("itM", glm::inverseTranspose(moon1.model));
+			planet.draw();
+		}
+		profiler.end(planetZone);
 
-		//moon rotation around the earth
-		moon1.model = glm::translate(moon1.model, glm::vec3(1.0, 0.0, 10.0));
-		moon1.model = glm::rotate(moon1.model, glm::radians((float)(3.0f)), glm::vec3(0.5, 1.0, 0.0));
-		moon1.model = glm::translate(moon1.model, glm::vec3(-1.0, 0.0, -10.0));
+		profiler.begin(moonZone);
+		if (isVisible(moon1)) {
+			earthShader.setMatrix4(earthM, moon1.shaderModel());
+			earthShader.setMatrix4(earthItM, scene.inverseTranspose(moonNode));
 
-		//moon texture
-		glBindTexture(GL_TEXTURE_2D, moon_t);
+			//moon texture
+			glState().bindTexture(GL_TEXTURE0, GL_TEXTURE_2D, moon_t);
 
-		glDepthFunc(GL_LEQUAL);
-		moon1.draw();
+			glState().depthFunc(GL_LEQUAL);
+			moon1.draw();
+		}
+		profiler.end(moonZone);
+
+		//asteroid belt, with the moon texture
+		if (!belt.empty()) {
+			profiler.begin(asteroidsZone);
+			updateAsteroidBelt(belt, beltCenter, simClock.renderTime(), asteroidTransforms);
+			for (size_t i = 0; i < belt.size(); i++) {
+				glm::vec3 center = glm::vec3(asteroidTransforms.world[i] * glm::vec4(asteroid.mesh->bounds.center, 1.0));
+				asteroidSpheres.x[i] = center.x;
+				asteroidSpheres.y[i] = center.y;
+				asteroidSpheres.z[i] = center.z;
+			}
+
+			//all the spheres of the belt in one batch
+			int visibleAsteroids = belt.size();
+			if (options.culling) {
+				visibleAsteroids = frustum.cull(asteroidSpheres, asteroidVisible);
+			}
+			else {
+				asteroidVisible.assign(belt.size(), 1);
+			}
+			drawnObjects += visibleAsteroids;
+			culledObjects += belt.size() - visibleAsteroids;
+			drawnTriangles += (long long)visibleAsteroids * asteroid.triangles();
+			fullTriangles += (long long)visibleAsteroids * asteroid.triangles();
+
+			glState().bindTexture(GL_TEXTURE0, GL_TEXTURE_2D, moon_t);
+			if (options.instancing) {
+				//the visible instances, sent again every frame since the belt moves
+				visibleInstances.clear();
+				for (size_t i = 0; i < belt.size(); i++) {
+					if (asteroidVisible[i]) visibleInstances.push_back(InstanceData{ asteroidTransforms.world[i], asteroidTransforms.normal[i] });
+				}
+				asteroid.updateInstances(visibleInstances);
+				if (asteroid.numInstances > 0) {
+					asteroidShader.use();
+					asteroid.drawInstanced();
+				}
+			}
+			else {
+				earthShader.use();
+				for (size_t i = 0; i < belt.size(); i++) {
+					if (!asteroidVisible[i]) continue;
+					earthShader.setMatrix4(earthM, asteroid.shaderModel(asteroidTransforms.world[i]));
+					earthShader.setMatrix4(earthItM, asteroidTransforms.normal[i]);
+					asteroid.draw();
+				}
+			}
+			profiler.end(asteroidsZone);
+		}
 
 		//reflective alien
+		profiler.begin(reflectiveZone);
+		if (isVisible(alien)) {
+			reflShader.use();
 
-		reflShader.use();
-
-		reflShader.setMatrix4("M", alien.model);
-		reflShader.setMatrix4("V", view);
-		reflShader.setMatrix4("P", perspective);
-
-		reflShader.setMatrix4("M", alien.model);
-		reflShader.setMatrix4("itM", glm::inverseTranspose(alien.model));
-
-		alien.model = glm::rotate(alien.model, glm::radians((float)(3.0f)), glm::vec3(1.0, 0.0, 1.0));
+			reflShader.setMatrix4(reflM, alien.shaderModel());
+			reflShader.setMatrix4(reflItM, scene.inverseTranspose(alienNode));
 
+			glState().bindTexture(GL_TEXTURE0, GL_TEXTURE_CUBE_MAP, cubeMapTexture);
 
-		glActiveTexture(GL_TEXTURE0);
-		glBindTexture(GL_TEXTURE_CUBE_MAP, cubeMapTexture);
-		cubeMapShader.setInteger("cubemapTexture", 0);
-
-		alien.draw();
+			alien.draw();
+		}
+		if (!bunnies.empty()) {
+			reflShader.use();
+			glState().bindTexture(GL_TEXTURE0, GL_TEXTURE_CUBE_MAP, cubeMapTexture);
+		}
+		for (size_t i = 0; i < bunnies.size(); i++) {
+			if (!isVisible(*bunnies[i])) continue;
+			reflShader.setMatrix4(reflM, bunnies[i]->shaderModel());
+			reflShader.setMatrix4(reflItM, bunnyNormals[i]);
+			bunnies[i]->draw();
+		}
+		profiler.end(reflectiveZone);
 
 		//refractive
+		profiler.begin(refractiveZone);
+		if (isVisible(alien2)) {
+			refrShader.use();
 
-		refrShader.use();
-
-		refrShader.setMatrix4("M", alien2.model);
-		refrShader.setMatrix4("V", view);
-		refrShader.setMatrix4("P", perspective);
-
-		refrShader.setMatrix4("M", alien2.model);
-		refrShader.setMatrix4("itM", glm::inverseTranspose(alien2.model));
+			refrShader.setMatrix4(refrM, alien2.shaderModel());
+			refrShader.setMatrix4(refrItM, scene.inverseTranspose(alien2Node));
 
-		alien2.model = glm::translate(alien2.model, glm::vec3(1.0, 0.0, 1.0));
-		alien2.model = glm::rotate(alien2.model, glm::radians((float)(2.0f)), glm::vec3(0.0, -1.0, 0.0));
-		alien2.model = glm::translate(alien2.model, glm::vec3(-1.0, 0.0, -1.0));
+			glState().bindTexture(GL_TEXTURE0, GL_TEXTURE_CUBE_MAP, cubeMapTexture);
 
-		glActiveTexture(GL_TEXTURE0);
-		glBindTexture(GL_TEXTURE_CUBE_MAP, cubeMapTexture);
-		cubeMapShader.setInteger("cubemapTexture", 0);
-		
-		glDepthFunc(GL_LEQUAL);
-		alien2.draw();
+			glState().depthFunc(GL_LEQUAL);
+			alien2.draw();
+		}
+		profiler.end(refractiveZone);
 
+		//the skybox surrounds the camera : never culled
+		profiler.begin(skyboxZone);
 		cubeMapShader.use();
-		cubeMapShader.setMatrix4("V", view);
-		cubeMapShader.setMatrix4("P", perspective);
-		cubeMapShader.setInteger("cubemapTexture", 0);
-		glActiveTexture(GL_TEXTURE0);
-		glBindTexture(GL_TEXTURE_CUBE_MAP, cubeMapTexture);
+		glState().depthFunc(GL_LEQUAL);
+		glState().bindTexture(GL_TEXTURE0, GL_TEXTURE_CUBE_MAP, cubeMapTexture);
 		cubeMap.draw();
-		glDepthFunc(GL_LESS);
+		glState().depthFunc(GL_LESS);
+		profiler.end(skyboxZone);
+
 
+		if (!options.headless) {
+			fps(now, glfwGetTime() - cpuStart);
+		}
+		glState().endFrame();
+		totalDrawn += drawnObjects;
+		totalCulled += culledObjects;
+		totalTriangles += drawnTriangles;
+		totalFullTriangles += fullTriangles;
+
+		if (options.headless) {
+			//no swap to wait on : finish the frame so its time includes the rendering
+			glFinish();
+		}
+		else {
+			glfwSwapBuffers(window);
+		}
+		frame++;
 
-		fps(now);
+		if (frame == 1) {
+			std::cout << "First frame after " << std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - startup).count()
+				<< " ms (" << textureLoader.pending() + textureStreamer.pending() << " textures still loading)" << std::endl;
+		}
+		if (texturesLoading && textureLoader.pending() == 0 && textureStreamer.pending() == 0) {
+			texturesLoading = false;
+			std::cout << "Textures ready after " << std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - startup).count()
+				<< " ms" << std::endl;
+		}
 
-		glfwSwapBuffers(window);
+	}
 
+	if (options.headless) {
+		double totalTime = glfwGetTime() - startTime;
+		std::cout << "Rendered " << frame << " frames in " << totalTime << " s (" << frame / totalTime << " FPS)" << std::endl;
+		if (frame > 0) {
+			std::cout << "Objects per frame : " << (double)totalDrawn / frame << " drawn, " << (double)totalCulled / frame << " culled"
+				<< (options.culling ? "" : " (culling off)") << std::endl;
+			std::cout << "Triangles per frame : " << (double)totalTriangles / frame << " submitted, " << (double)totalFullTriangles / frame << " at full detail"
+				<< (options.lod ? "" : " (LOD off)") << std::endl;
+			std::cout << "Scene graph : " << scene.size() << " nodes, " << (double)sceneUpdates / frame << " updated per frame" << std::endl;
+			std::cout << "Simulation : " << simClock.stepCount() << " steps of " << 1000.0 * simClock.step << " ms, "
+				<< simClock.time() << " s of scene time" << std::endl;
+			std::cout << "Gravity : " << bodies.size() << " bodies, energy drift " << (bodies.energy() - initialEnergy) / std::abs(initialEnergy) << std::endl;
+			for (VertexFormat format : { VertexFormat::Float, VertexFormat::Packed }) {
+				const GeometryPool& pool = geometryPool(format);
+				if (pool.meshes() == 0) continue;
+				std::cout << "Geometry pool (" << (format == VertexFormat::Packed ? "packed" : "float") << ") : " << pool.meshes() << " meshes, "
+					<< pool.residentBytes() / 1024 << " KB resident of " << pool.capacityBytes() / 1024 << " KB (" << pool.generation() << " grows), "
+					<< pool.vertices().freeBlocks() << " + " << pool.indices().freeBlocks() << " free blocks, fragmentation "
+					<< 100.0f * pool.vertices().fragmentation() << "% / " << 100.0f * pool.indices().fragmentation() << "%" << std::endl;
+			}
+		}
 	}
 
-	//clean up ressource
-	glfwDestroyWindow(window);
-	glfwTerminate();
+	profiler.finish();
+	profiler.report();
+	if (!options.profileCSV.empty()) profiler.exportCSV(options.profileCSV.c_str());
+	if (!options.profileTrace.empty()) profiler.exportTrace(options.profileTrace.c_str());
 
+	//clean up ressource : objects, then the context (see ContextGuard)
 	return 0;
 }
 
-void loadCubemapFace(const char* path, const GLenum& targetFace)
-{
-	int imWidth, imHeight, imNrChannels;
-	unsigned char* data = stbi_load(path, &imWidth, &imHeight, &imNrChannels, 0);
-	if (data)
-	{
-
-		glTexImage2D(targetFace, 0, GL_RGB, imWidth, imHeight, 0, GL_RGB, GL_UNSIGNED_BYTE, data);
-		//glGenerateMipmap(targetFace);
-	}
-	else {
-		std::cout << "Failed to Load texture" << std::endl;
-		const char* reason = stbi_failure_reason();
-		std::cout << reason << std::endl;
-	}
-	stbi_image_free(data);
-}
+/* The camera used to move by a fixed amount per frame (0.1 for a move, 1 for a turn) : it now moves per second,
+* at the speed it had at 60 frames per second.
+*/
+void processInput(GLFWwindow* window, float deltaTime) {
+	const float move = 6.0f * deltaTime;
+	const float turn = 60.0f * deltaTime;
 
-void processInput(GLFWwindow* window) {
 	if (glfwGetKey(window, GLFW_KEY_ESCAPE) == GLFW_PRESS)
 		glfwSetWindowShouldClose(window, true);
 
 	if (glfwGetKey(window, GLFW_KEY_A) == GLFW_PRESS)
-		camera.ProcessKeyboardMovement(LEFT, 0.1);
+		camera.ProcessKeyboardMovement(LEFT, move);
 	if (glfwGetKey(window, GLFW_KEY_D) == GLFW_PRESS)
-		camera.ProcessKeyboardMovement(RIGHT, 0.1);
+		camera.ProcessKeyboardMovement(RIGHT, move);
 
 	if (glfwGetKey(window, GLFW_KEY_W) == GLFW_PRESS)
-		camera.ProcessKeyboardMovement(FORWARD, 0.1);
+		camera.ProcessKeyboardMovement(FORWARD, move);
 	if (glfwGetKey(window, GLFW_KEY_S) == GLFW_PRESS)
-		camera.ProcessKeyboardMovement(BACKWARD, 0.1);
+		camera.ProcessKeyboardMovement(BACKWARD, move);
 
 	if (glfwGetKey(window, GLFW_KEY_RIGHT) == GLFW_PRESS)
-		camera.ProcessKeyboardRotation(1, 0.0, 1);
+		camera.ProcessKeyboardRotation(1, 0.0, turn);
 	if (glfwGetKey(window, GLFW_KEY_LEFT) == GLFW_PRESS)
-		camera.ProcessKeyboardRotation(-1, 0.0, 1);
+		camera.ProcessKeyboardRotation(-1, 0.0, turn);
 
 	if (glfwGetKey(window, GLFW_KEY_UP) == GLFW_PRESS)
-		camera.ProcessKeyboardRotation(0.0, 1.0, 1);
+		camera.ProcessKeyboardRotation(0.0, 1.0, turn);
 	if (glfwGetKey(window, GLFW_KEY_DOWN) == GLFW_PRESS)
-		camera.ProcessKeyboardRotation(0.0, -1.0, 1);
+		camera.ProcessKeyboardRotation(0.0, -1.0, turn);
+
 
+}
+
+//OpenGL format of an image with this number of channels
+GLenum pixelFormat(int channels) {
+	switch (channels) {
+	case 1: return GL_RED;
+	case 2: return GL_RG;
+	case 4: return GL_RGBA;
+	default: return GL_RGB;
+	}
+}
+
+void setTextureParameters(GLenum target) {
+	if (target == GL_TEXTURE_CUBE_MAP) {
+		glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+		glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+		glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
+		glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+		glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	}
+	else {
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_MIRRORED_REPEAT);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_MIRRORED_REPEAT);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	}
+}
+
+//texture object that the streamer fills, it takes the place of the placeholder when complete
+GLuint createStreamedTexture(GLenum target) {
+	GLuint streamed;
+	glGenTextures(1, &streamed);
+	glState().bindTexture(GL_TEXTURE0, target, streamed);
+	setTextureParameters(target);
+	return streamed;
+}
 
+void replaceTexture(GLuint& texture, GLuint streamed, GLenum target) {
+	//unbind first : the cache must not keep a deleted name
+	glState().bindTexture(GL_TEXTURE0, target, 0);
+	glDeleteTextures(1, &texture);
+	texture = streamed;
 }
 
-void defineTexture(GLuint& texture, const char* path) {
+//stream the texture baked by --bake-textures, returns false if there is none (or it is stale, or the driver cannot read BC1 / BC3)
+bool loadBakedTexture(GLuint* handle, GLenum target, const std::string& path, const std::vector<std::string>& sources, TextureStreamer& streamer) {
+	//the sources are decoded instead
+	if (!GLAD_GL_EXT_texture_compression_s3tc) {
+		return false;
+	}
+	std::shared_ptr<TextureFile> file = std::make_shared<TextureFile>();
+	if (!file->open(path.c_str(), sources)) {
+		return false;
+	}
+	const TextureFileHeader& header = *file->header;
+
+	GLuint streamed = createStreamedTexture(target);
+	//every level is in the file
+	glTexParameteri(target, GL_TEXTURE_MAX_LEVEL, header.levels - 1);
+
+	std::vector<TextureStreamer::Level> levels;
+	for (uint32_t face = 0; face < header.faces; face++) {
+		GLenum faceTarget = target == GL_TEXTURE_CUBE_MAP ? GL_TEXTURE_CUBE_MAP_POSITIVE_X + face : target;
+		for (uint32_t level = 0; level < header.levels; level++) {
+			const TextureFileLevel& l = file->level(face, level);
+			TextureStreamer::Level streamLevel = { faceTarget, (GLint)level, (GLint)header.format, (int)l.width, (int)l.height, GL_RGBA, 0, file->data(face, level) };
+			streamLevel.blockBytes = blockBytes(header.format);
+			levels.push_back(streamLevel);
+		}
+	}
+	streamer.stream(streamed, target, levels, file, [handle, streamed, target]() {
+		replaceTexture(*handle, streamed, target);
+	});
+	return true;
+}
+
+void defineTexture(GLuint& texture, const char* path, TextureLoader& loader, TextureStreamer& streamer) {
 	glGenTextures(1, &texture);
-	glBindTexture(GL_TEXTURE_2D, texture);
+	glState().bindTexture(GL_TEXTURE0, GL_TEXTURE_2D, texture);
+	setTextureParameters(GL_TEXTURE_2D);
 
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_MIRRORED_REPEAT);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_MIRRORED_REPEAT);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-	int width, height, nrChannels;
-	stbi_set_flip_vertically_on_load(true);
+	//grey placeholder until the image is uploaded
+	const unsigned char placeholder[4] = { 128, 128, 128, 255 };
+	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, 1, 1, 0, GL_RGBA, GL_UNSIGNED_BYTE, placeholder);
+	glGenerateMipmap(GL_TEXTURE_2D);
 
-	unsigned char* data = stbi_load(path, &width, &height, &nrChannels, 0);
-	if (data) {
-		glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, width, height, 0, GL_RGB, GL_UNSIGNED_BYTE, data);
-		glGenerateMipmap(GL_TEXTURE_2D);
+	GLuint* handle = &texture;
+	if (loadBakedTexture(handle, GL_TEXTURE_2D, textureFilePath(path), { path }, streamer)) {
+		return;
 	}
-	else {
-		std::cout << "Failed to Load texture" << std::endl;
-		const char* reason = stbi_failure_reason();
-		std::cout << reason << std::endl;
+
+	loader.load({ path }, true, [handle, &streamer](std::vector<Image>& images) {
+		if (!images[0].pixels) return;
+		std::shared_ptr<Image> image = std::make_shared<Image>(std::move(images[0]));
+		GLenum format = pixelFormat(image->channels);
+
+		GLuint streamed = createStreamedTexture(GL_TEXTURE_2D);
+		TextureStreamer::Level level = { GL_TEXTURE_2D, 0, format == GL_RGBA ? GL_RGBA : GL_RGB, image->width, image->height, format, image->channels, image->pixels };
+		streamer.stream(streamed, GL_TEXTURE_2D, { level }, image, [handle, streamed]() {
+			glState().bindTexture(GL_TEXTURE0, GL_TEXTURE_2D, streamed);
+			glGenerateMipmap(GL_TEXTURE_2D);
+			replaceTexture(*handle, streamed, GL_TEXTURE_2D);
+		});
+	});
+}
+
+//the faces in the order of their targets (+X, -X, +Y, -Y, +Z, -Z), as stored in a baked cubemap
+std::vector<std::string> cubemapSources(const std::map<std::string, GLenum>& faces) {
+	std::vector<std::string> sources(6);
+	for (const std::pair<const std::string, GLenum>& face : faces) {
+		sources[face.second - GL_TEXTURE_CUBE_MAP_POSITIVE_X] = face.first;
+	}
+	return sources;
+}
+
+//a baked cubemap is stored next to its faces
+std::string cubemapFilePath(const std::map<std::string, GLenum>& faces) {
+	std::string first = faces.begin()->first;
+	return textureFilePath(first.substr(0, first.find_last_of("/\\") + 1) + "cubemap");
+}
+
+//the six faces are streamed once they are all decoded, the placeholder stays until the last row is sent
+void defineCubemap(GLuint& texture, const std::map<std::string, GLenum>& faces, TextureLoader& loader, TextureStreamer& streamer) {
+	glGenTextures(1, &texture);
+	glState().bindTexture(GL_TEXTURE0, GL_TEXTURE_CUBE_MAP, texture);
+	setTextureParameters(GL_TEXTURE_CUBE_MAP);
+
+	//black placeholder faces, one level : complete with the mipmap filter (the streamed texture replaces it)
+	glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAX_LEVEL, 0);
+	std::vector<std::string> paths;
+	std::vector<GLenum> targets;
+	const unsigned char placeholder[4] = { 0, 0, 0, 255 };
+	for (const std::pair<const std::string, GLenum>& face : faces) {
+		paths.push_back(face.first);
+		targets.push_back(face.second);
+		glTexImage2D(face.second, 0, GL_RGBA, 1, 1, 0, GL_RGBA, GL_UNSIGNED_BYTE, placeholder);
 	}
-	stbi_image_free(data);
-}
\ No newline at end of file
+
+	GLuint* handle = &texture;
+	if (loadBakedTexture(handle, GL_TEXTURE_CUBE_MAP, cubemapFilePath(faces), cubemapSources(faces), streamer)) {
+		return;
+	}
+
+	loader.load(paths, false, [handle, targets, &streamer](std::vector<Image>& images) {
+		//a cubemap with faces of different sizes is incomplete
+		for (const Image& image : images) {
+			if (!image.pixels || image.width != images[0].width || image.height != images[0].height) return;
+		}
+		std::shared_ptr<std::vector<Image>> owner = std::make_shared<std::vector<Image>>(std::move(images));
+
+		GLuint streamed = createStreamedTexture(GL_TEXTURE_CUBE_MAP);
+		//not baked : no mipmaps, the faces are too large to build them at runtime
+		glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAX_LEVEL, 0);
+		std::vector<TextureStreamer::Level> levels;
+		for (size_t i = 0; i < owner->size(); i++) {
+			const Image& image = (*owner)[i];
+			GLenum format = pixelFormat(image.channels);
+			levels.push_back({ targets[i], 0, format == GL_RGBA ? GL_RGBA : GL_RGB, image.width, image.height, format, image.channels, image.pixels });
+		}
+		streamer.stream(streamed, GL_TEXTURE_CUBE_MAP, levels, owner, [handle, streamed]() {
+			replaceTexture(*handle, streamed, GL_TEXTURE_CUBE_MAP);
+		});
+	});
+}
@@ -0,0 +1,339 @@
+#ifndef MESH_H
+#define MESH_H
+
+#include<iostream>
+#include <string>
+#include <vector>
+#include <memory>
+#include <unordered_map>
+#include <cstdlib>
+#include <stdexcept>
+
+#include <glad/glad.h>
+
+#include <glm/glm.hpp>
+
+#include "objParser.h"
+#include "meshCache.h"
+#include "frustum.h"
+#include "simplify.h"
+#include "vertexCache.h"
+#include "quantize.h"
+#include "vertexLayout.h"
+#include "geometryPool.h"
+
+/* Mesh : the geometry of an OBJ file, on the CPU until upload() then on the GPU (VBO + EBO + VAO).
+* It does not know where it is drawn : the transform belongs to each Object using it,
+* so several objects can share one mesh through the MeshRegistry. The VAO works with any shader (see vertexLayout.h).
+* An indexed mesh also holds its levels of detail : ranges of the same index buffer, level 0 is the full mesh.
+* An indexed mesh is uploaded into the GeometryPool of its vertex format : the buffers and the VAO are then the pool's
+* (VBO and EBO stay 0, see vertexBuffer / indexBuffer), and the mesh starts at baseVertex / firstIndex in them.
+*/
+
+//one pool per vertex format, each one as large as its meshes need
+inline GeometryPool& geometryPool(VertexFormat format) {
+	static GeometryPool floatPool(VertexFormat::Float);
+	static GeometryPool packedPool(VertexFormat::Packed);
+	return format == VertexFormat::Packed ? packedPool : floatPool;
+}
+
+
+class Mesh
+{
+public:
+	std::vector<Vertex> vertices;
+	std::vector<GLuint> indices;
+
+	//what upload() sends : points either in vertices/indices or in the mapped mesh cache
+	const Vertex* vertexData = nullptr;
+	const GLuint* indexData = nullptr;
+
+	int numVertices = 0;
+	int numIndices = 0;
+
+	//indexed : identical corners share one vertex and are drawn with glDrawElements
+	bool indexed;
+
+	//levels of detail, from the full mesh to the coarsest (a single level for the expanded layout)
+	std::vector<MeshLod> lods;
+
+	//packed vertices are read in [0, 1] : decode brings them back to model space (identity for Float)
+	VertexFormat format;
+	glm::mat4 decode = glm::mat4(1.0);
+
+	//bounding box and sphere (around the center of the box) in model space
+	glm::vec3 boundsMin = glm::vec3(0.0);
+	glm::vec3 boundsMax = glm::vec3(0.0);
+	BoundingSphere bounds = { glm::vec3(0.0), 0.0f };
+
+	GLuint VBO = 0, EBO = 0, VAO = 0;
+
+	//pool holding the buffers (nullptr : VBO and EBO belong to the mesh), offsets of the mesh in them
+	GeometryPool* pool = nullptr;
+	GLint baseVertex = 0;
+	size_t firstIndex = 0;
+
+	Mesh(const char* path, bool indexed = true, VertexFormat format = VertexFormat::Float) : indexed(indexed), format(format) {
+
+		//the binary cache only exists for the indexed layout
+		std::string cachePath = meshCachePath(path);
+		if (indexed && cache.open(cachePath.c_str(), path, sizeof(Vertex))) {
+			vertexData = (const Vertex*)cache.vertices();
+			indexData = cache.indices();
+			numVertices = cache.header->vertexCount;
+			numIndices = cache.header->indexCount;
+			lods.assign(cache.lods(), cache.lods() + cache.header->lodCount);
+			boundsMin = glm::vec3(cache.header->boundsMin[0], cache.header->boundsMin[1], cache.header->boundsMin[2]);
+			boundsMax = glm::vec3(cache.header->boundsMax[0], cache.header->boundsMax[1], cache.header->boundsMax[2]);
+			computeSphere();
+			std::cout << "Load model from cache with " << numVertices << " unique vertices for " << numIndices << " indices" << std::endl;
+			return;
+		}
+
+		ObjData data;
+		if (!loadObj(path, data)) {
+			throw std::runtime_error("Failed to load model " + std::string(path));
+		}
+
+		std::unordered_map<VertexKey, GLuint, VertexKeyHash> uniqueVertices;
+		if (indexed) {
+			uniqueVertices.reserve(data.corners.size());
+			indices.reserve(data.corners.size());
+		}
+		else {
+			vertices.reserve(data.corners.size());
+		}
+		for (const VertexKey& key : data.corners) {
+			addCorner(data, key, uniqueVertices);
+		}
+
+		if (indexed) {
+			lods = buildLods(vertices, indices);
+			optimizeForGPU();
+		}
+		else {
+			lods.push_back(MeshLod{ 0, (uint32_t)vertices.size(), 0.0f });
+		}
+
+		vertexData = vertices.data();
+		indexData = indices.data();
+		numVertices = vertices.size();
+		numIndices = indices.size();
+
+		if (!vertices.empty()) {
+			boundsMin = boundsMax = vertices[0].Position;
+			for (const Vertex& v : vertices) {
+				boundsMin = glm::min(boundsMin, v.Position);
+				boundsMax = glm::max(boundsMax, v.Position);
+			}
+		}
+		computeSphere();
+
+		if (indexed) {
+			std::cout << "Load model with " << numVertices << " unique vertices for " << numIndices << " indices ("
+				<< (sizeof(Vertex) * numVertices + sizeof(GLuint) * numIndices) / 1024 << " KB with the LODs, "
+				<< sizeof(Vertex) * lods[0].indexCount / 1024 << " KB expanded), LODs :";
+			for (const MeshLod& lod : lods) {
+				std::cout << " " << lod.indexCount / 3;
+			}
+			std::cout << " triangles" << std::endl;
+			if (!writeMeshCache(cachePath.c_str(), path, vertexData, sizeof(Vertex), numVertices, indexData, numIndices, lods.data(), lods.size(), boundsMin, boundsMax)) {
+				std::cout << "Could not write mesh cache " << cachePath << std::endl;
+			}
+		}
+		else {
+			std::cout << "Load model with " << numVertices << " vertices" << std::endl;
+		}
+	}
+
+	Mesh(const Mesh&) = delete;
+	Mesh& operator=(const Mesh&) = delete;
+
+	~Mesh() {
+		if (pool) {
+			pool->release(allocation);
+			return;
+		}
+		if (VAO) {
+			//the name may be reused by a later VAO : do not leave it in the state cache
+			glState().bindVertexArray(0);
+			glDeleteVertexArrays(1, &VAO);
+		}
+		if (VBO) glDeleteBuffers(1, &VBO);
+		if (EBO) glDeleteBuffers(1, &EBO);
+	}
+
+	//buffers holding the mesh : its own or the ones of its pool (they change when the pool grows)
+	GLuint vertexBuffer() const {
+		return pool ? pool->vertexBuffer() : VBO;
+	}
+
+	GLuint indexBuffer() const {
+		return pool ? pool->indexBuffer() : EBO;
+	}
+
+	//create the GPU buffers the first time, then release the CPU copy
+	void upload() {
+		if (VAO) return;
+
+		const void* uploaded = vertexData;
+		size_t uploadedSize = sizeof(Vertex) * numVertices;
+		std::vector<PackedVertex> packed;
+		if (format == VertexFormat::Packed) {
+			//the cache keeps the float vertices, they are packed here
+			QuantizationError error = packVertices(vertexData, numVertices, boundsMin, boundsMax, packed);
+			decode = decodeMatrix(boundsMin, boundsMax);
+			uploaded = packed.data();
+			uploadedSize = sizeof(PackedVertex) * numVertices;
+			std::cout << "Packed " << numVertices << " vertices (" << sizeof(Vertex) * numVertices / 1024 << " KB -> " << sizeof(PackedVertex) * numVertices / 1024
+				<< " KB), largest error : position " << error.position << " (" << 100.0f * error.relativePosition << "% of the box), normal "
+				<< error.normal << " degrees, texture " << error.texture << std::endl;
+		}
+
+		GeometryPool& shared = geometryPool(format);
+		if (indexed && shared.allocate(uploaded, numVertices, indexData, numIndices, allocation)) {
+			pool = &shared;
+			VAO = shared.vertexArray();
+			baseVertex = (GLint)allocation.baseVertex;
+			firstIndex = allocation.firstIndex;
+			releaseCPU();
+			return;
+		}
+		glGenBuffers(1, &VBO);
+		glBindBuffer(GL_ARRAY_BUFFER, VBO);
+		glBufferData(GL_ARRAY_BUFFER, uploadedSize, uploaded, GL_STATIC_DRAW);
+		glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+		if (indexed) {
+			glGenBuffers(1, &EBO);
+			//GL_COPY_WRITE_BUFFER : binding GL_ELEMENT_ARRAY_BUFFER here would change the currently bound VAO
+			glBindBuffer(GL_COPY_WRITE_BUFFER, EBO);
+			glBufferData(GL_COPY_WRITE_BUFFER, sizeof(GLuint) * numIndices, indexData, GL_STATIC_DRAW);
+			glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+		}
+		VAO = createVertexArray(format, VBO, EBO);
+		releaseCPU();
+	}
+
+	//write (or refresh) the binary cache of an OBJ without any OpenGL context
+	static void bakeCache(const char* path) {
+		try {
+			Mesh mesh(path);
+		}
+		catch (const std::exception& e) {
+			//the other files are still baked
+			std::cout << e.what() << std::endl;
+		}
+	}
+
+private:
+	MeshCache cache;
+	PoolAllocation allocation;
+
+	//the data now lives on the GPU
+	void releaseCPU() {
+		cache.close();
+		std::vector<Vertex>().swap(vertices);
+		std::vector<GLuint>().swap(indices);
+		vertexData = nullptr;
+		indexData = nullptr;
+	}
+
+	//append a face corner, reusing the vertex if this corner was already seen
+	void addCorner(const ObjData& data, const VertexKey& key, std::unordered_map<VertexKey, GLuint, VertexKeyHash>& uniqueVertices) {
+		if (indexed) {
+			auto found = uniqueVertices.find(key);
+			if (found != uniqueVertices.end()) {
+				indices.push_back(found->second);
+				return;
+			}
+			GLuint index = vertices.size();
+			uniqueVertices.emplace(key, index);
+			indices.push_back(index);
+		}
+
+		Vertex v;
+		v.Position = data.positions.at(key.p);
+		v.Normal = key.n >= 0 ? data.normals.at(key.n) : glm::vec3(0.0);
+		v.Texture = key.t >= 0 ? data.textures.at(key.t) : glm::vec2(0.0);
+		vertices.push_back(v);
+	}
+
+	//triangle order of every LOD for the vertex cache and overdraw, then vertex order for the fetches (see vertexCache.h)
+	void optimizeForGPU() {
+		VertexCacheStats before = analyzeVertexCache(indices.data(), lods[0].indexCount, vertices.size());
+		for (const MeshLod& lod : lods) {
+			optimizeVertexCache(&indices[lod.firstIndex], lod.indexCount, vertices.size());
+			optimizeOverdraw(&indices[lod.firstIndex], lod.indexCount, vertices.data(), vertices.size());
+		}
+		optimizeVertexFetch(vertices, indices);
+		VertexCacheStats after = analyzeVertexCache(indices.data(), lods[0].indexCount, vertices.size());
+		std::cout << "Vertex cache : ACMR " << before.acmr << " -> " << after.acmr << ", ATVR " << before.atvr << " -> " << after.atvr << std::endl;
+	}
+
+	//sphere around the center of the box, through the furthest vertex (tighter than the half diagonal)
+	void computeSphere() {
+		bounds.center = 0.5f * (boundsMin + boundsMax);
+		float radius2 = 0.0f;
+		for (int i = 0; i < numVertices; i++) {
+			glm::vec3 d = vertexData[i].Position - bounds.center;
+			radius2 = std::max(radius2, glm::dot(d, d));
+		}
+		bounds.radius = std::sqrt(radius2);
+	}
+};
+
+
+/* Registry of the loaded meshes, keyed by absolute path (and layouts) :
+* asking twice for the same file returns the same Mesh, which is freed once no Object uses it anymore.
+*/
+class MeshRegistry
+{
+public:
+	std::shared_ptr<Mesh> load(const char* path, bool indexed = true, VertexFormat format = VertexFormat::Float) {
+		std::string key = absolutePath(path) + (indexed ? "" : "#expanded") + (format == VertexFormat::Packed ? "#packed" : "");
+		auto found = meshes.find(key);
+		if (found != meshes.end()) {
+			std::shared_ptr<Mesh> mesh = found->second.lock();
+			if (mesh) {
+				std::cout << "Reuse model " << path << std::endl;
+				return mesh;
+			}
+		}
+		std::shared_ptr<Mesh> mesh = std::make_shared<Mesh>(path, indexed, format);
+		meshes[key] = mesh;
+		return mesh;
+	}
+
+	//number of meshes currently alive
+	size_t size() const {
+		size_t alive = 0;
+		for (const auto& entry : meshes) {
+			if (!entry.second.expired()) alive++;
+		}
+		return alive;
+	}
+
+private:
+	std::unordered_map<std::string, std::weak_ptr<Mesh>> meshes;
+
+	static std::string absolutePath(const char* path) {
+#ifdef _WIN32
+		char buffer[_MAX_PATH];
+		return _fullpath(buffer, path, _MAX_PATH) ? std::string(buffer) : std::string(path);
+#else
+		char* resolved = realpath(path, nullptr);
+		if (!resolved) return std::string(path);
+		std::string result(resolved);
+		free(resolved);
+		return result;
+#endif
+	}
+};
+
+inline MeshRegistry& meshRegistry() {
+	static MeshRegistry registry;
+	return registry;
+}
+
+#endif
@@ -0,0 +1,212 @@
+#ifndef MESH_CACHE_H
+#define MESH_CACHE_H
+
+#include <iostream>
+#include <string>
+#include <cstdio>
+#include <cstdint>
+#include <cstddef>
+#include <cstring>
+
+#include <sys/types.h>
+#include <sys/stat.h>
+
+#include "objParser.h"
+#include "simplify.h"
+
+/* Binary mesh cache :
+* after the first parse of "mesh.obj", the ready to upload vertex and index arrays are written to "mesh.obj.mesh".
+* Later runs map that file and hand its arrays straight to glBufferData.
+* The cache stores the size, modification time and hash of the OBJ it was built from to detect when it is stale.
+*
+* The levels of detail (see simplify.h) are part of the cache : their indices follow those of the mesh.
+* The triangles and vertices are stored in the order of vertexCache.h.
+*
+* layout : MeshCacheHeader | vertexCount * vertexSize bytes | indexCount * uint32 indices | lodCount * MeshLod
+*/
+
+const char meshCacheMagic[4] = { 'M', 'E', 'S', 'H' };
+const uint32_t meshCacheVersion = 4;
+
+struct MeshCacheHeader {
+	char magic[4];
+	uint32_t version;
+	//source OBJ
+	uint64_t sourceSize;
+	int64_t sourceTime;
+	uint64_t sourceHash;
+	//content
+	uint32_t vertexSize;
+	uint32_t vertexCount;
+	uint32_t indexCount;
+	uint32_t lodCount;
+	float boundsMin[3];
+	float boundsMax[3];
+};
+
+inline std::string meshCachePath(const char* objPath) {
+	return std::string(objPath) + ".mesh";
+}
+
+//FNV-1a, 64 bits
+inline uint64_t hashBytes(const char* bytes, size_t size) {
+	uint64_t hash = 14695981039346656037ull;
+	for (size_t i = 0; i < size; i++) {
+		hash ^= (unsigned char)bytes[i];
+		hash *= 1099511628211ull;
+	}
+	return hash;
+}
+
+inline bool statFile(const char* path, uint64_t& size, int64_t& time) {
+#ifdef _WIN32
+	struct _stat64 st;
+	if (_stat64(path, &st) != 0) return false;
+#else
+	struct stat st;
+	if (stat(path, &st) != 0) return false;
+#endif
+	size = (uint64_t)st.st_size;
+	time = (int64_t)st.st_mtime;
+	return true;
+}
+
+inline bool hashFile(const char* path, uint64_t& hash) {
+	MappedFile file;
+	if (!file.open(path)) return false;
+	hash = hashBytes(file.data(), file.size());
+	return true;
+}
+
+
+//read side : maps a cache file and checks it against its OBJ
+class MeshCache
+{
+public:
+	const MeshCacheHeader* header = nullptr;
+
+	//returns false if the cache is missing, corrupted or older than the OBJ (or the OBJ cannot be read : nothing to check it against)
+	bool open(const char* cachePath, const char* objPath, uint32_t vertexSize) {
+		int64_t time;
+		if (!map(cachePath, objPath, vertexSize, time)) {
+			return false;
+		}
+		if (time != header->sourceTime) {
+			//same content, new time (copy, checkout...) : store the time, the next runs do not hash the OBJ again
+			close();
+			writeSourceTime(cachePath, time);
+			return map(cachePath, objPath, vertexSize, time);
+		}
+		return true;
+	}
+
+	const void* vertices() const {
+		return file.data() + sizeof(MeshCacheHeader);
+	}
+
+	const uint32_t* indices() const {
+		return (const uint32_t*)(file.data() + sizeof(MeshCacheHeader) + (size_t)header->vertexCount * header->vertexSize);
+	}
+
+	const MeshLod* lods() const {
+		return (const MeshLod*)(indices() + header->indexCount);
+	}
+
+	void close() {
+		file.close();
+		header = nullptr;
+	}
+
+private:
+	MappedFile file;
+
+	//open and check the cache, time : the one of the OBJ now
+	bool map(const char* cachePath, const char* objPath, uint32_t vertexSize, int64_t& time) {
+		header = nullptr;
+		if (!file.open(cachePath) || file.size() < sizeof(MeshCacheHeader)) {
+			return false;
+		}
+		const MeshCacheHeader* h = (const MeshCacheHeader*)file.data();
+		bool valid = memcmp(h->magic, meshCacheMagic, 4) == 0 && h->version == meshCacheVersion && h->vertexSize == vertexSize
+			&& h->lodCount > 0
+			&& file.size() == sizeof(MeshCacheHeader) + (uint64_t)h->vertexCount * vertexSize + (uint64_t)h->indexCount * sizeof(uint32_t)
+			+ (uint64_t)h->lodCount * sizeof(MeshLod);
+
+		uint64_t size;
+		//a different time alone (copy, checkout...) does not make the cache stale if the content is the same
+		uint64_t hash;
+		valid = valid && statFile(objPath, size, time) && size == h->sourceSize
+			&& (time == h->sourceTime || (hashFile(objPath, hash) && hash == h->sourceHash));
+		if (!valid) {
+			file.close();
+			return false;
+		}
+		header = h;
+
+		//the arrays go to glDrawElements as they are : a corrupted cache of the right size must not read out of the buffers
+		const uint32_t* index = indices();
+		for (uint32_t i = 0; valid && i < h->indexCount; i++) {
+			valid = index[i] < h->vertexCount;
+		}
+		const MeshLod* lod = lods();
+		for (uint32_t i = 0; valid && i < h->lodCount; i++) {
+			valid = lod[i].firstIndex <= h->indexCount && lod[i].indexCount <= h->indexCount - lod[i].firstIndex;
+		}
+		if (!valid) {
+			close();
+			return false;
+		}
+		return true;
+	}
+
+	//rewrite the source time of the header in place (nothing if the cache is read-only)
+	static void writeSourceTime(const char* cachePath, int64_t time) {
+		FILE* out = fopen(cachePath, "r+b");
+		if (!out) return;
+		if (fseek(out, offsetof(MeshCacheHeader, sourceTime), SEEK_SET) == 0) {
+			fwrite(&time, sizeof(time), 1, out);
+		}
+		fclose(out);
+	}
+};
+
+
+//write side : returns false if the cache could not be written (read-only folder...)
+inline bool writeMeshCache(const char* cachePath, const char* objPath, const void* vertices, uint32_t vertexSize, uint32_t vertexCount,
+	const uint32_t* indices, uint32_t indexCount, const MeshLod* lods, uint32_t lodCount, const glm::vec3& boundsMin, const glm::vec3& boundsMax) {
+
+	MeshCacheHeader header;
+	memset(&header, 0, sizeof(header));
+	memcpy(header.magic, meshCacheMagic, 4);
+	header.version = meshCacheVersion;
+	if (!statFile(objPath, header.sourceSize, header.sourceTime) || !hashFile(objPath, header.sourceHash)) {
+		return false;
+	}
+	header.vertexSize = vertexSize;
+	header.vertexCount = vertexCount;
+	header.indexCount = indexCount;
+	header.lodCount = lodCount;
+	memcpy(header.boundsMin, &boundsMin[0], sizeof(header.boundsMin));
+	memcpy(header.boundsMax, &boundsMax[0], sizeof(header.boundsMax));
+
+	//write next to the final file then rename, a crash never leaves a half written cache behind
+	std::string tmpPath = std::string(cachePath) + ".tmp";
+	FILE* out = fopen(tmpPath.c_str(), "wb");
+	if (!out) {
+		return false;
+	}
+	bool ok = fwrite(&header, sizeof(header), 1, out) == 1;
+	ok = ok && (vertexCount == 0 || fwrite(vertices, vertexSize, vertexCount, out) == vertexCount);
+	ok = ok && (indexCount == 0 || fwrite(indices, sizeof(uint32_t), indexCount, out) == indexCount);
+	ok = ok && (lodCount == 0 || fwrite(lods, sizeof(MeshLod), lodCount, out) == lodCount);
+	ok = fclose(out) == 0 && ok;
+
+	std::remove(cachePath);
+	if (!ok || std::rename(tmpPath.c_str(), cachePath) != 0) {
+		std::remove(tmpPath.c_str());
+		return false;
+	}
+	return true;
+}
+
+#endif
@@ -0,0 +1,376 @@
+#ifndef NBODY_H
+#define NBODY_H
+
+#include<iostream>
+#include <vector>
+#include <thread>
+#include <functional>
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+
+#include <glm/glm.hpp>
+
+#if defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+#include <xmmintrin.h>
+#define NBODY_SSE
+#endif
+
+/* N-body gravity :
+* the bodies are stored as structure of arrays, step() integrates them with leapfrog (kick-drift-kick),
+* which is symplectic : the energy oscillates but does not drift, the orbits stay closed over long runs.
+* The accelerations come either from every pair (O(N^2), four bodies at a time with SSE, split over threads)
+* or from a Barnes-Hut octree (O(N log N)) : a cell seen under an angle smaller than theta acts as one body at its
+* center of mass. The octree is built from the bodies sorted by Morton code, the leaves hold a few bodies.
+* The gravity is softened (Plummer) so that close encounters stay finite.
+*/
+class NBodySystem
+{
+public:
+	enum Method { Direct, BarnesHut };
+
+	std::vector<float> x, y, z;
+	std::vector<float> vx, vy, vz;
+	std::vector<float> ax, ay, az;
+	std::vector<float> mass;
+
+	float G = 1.0f;
+	float softening = 1e-3f;
+	Method method = Direct;
+	//opening angle of Barnes-Hut : smaller is more accurate and slower
+	float theta = 0.5f;
+	unsigned threads = 1;
+
+	size_t add(const glm::vec3& position, const glm::vec3& velocity, float m) {
+		x.push_back(position.x);
+		y.push_back(position.y);
+		z.push_back(position.z);
+		vx.push_back(velocity.x);
+		vy.push_back(velocity.y);
+		vz.push_back(velocity.z);
+		ax.push_back(0.0f);
+		ay.push_back(0.0f);
+		az.push_back(0.0f);
+		mass.push_back(m);
+		accelerationsValid = false;
+		return size() - 1;
+	}
+
+	size_t size() const {
+		return x.size();
+	}
+
+	glm::vec3 position(size_t i) const {
+		return glm::vec3(x[i], y[i], z[i]);
+	}
+
+	glm::vec3 velocity(size_t i) const {
+		return glm::vec3(vx[i], vy[i], vz[i]);
+	}
+
+	//one leapfrog step of dt : half kick, drift, new accelerations, half kick
+	void step(float dt) {
+		if (!accelerationsValid) computeAccelerations();
+		kick(0.5f * dt);
+		for (size_t i = 0; i < size(); i++) {
+			x[i] += vx[i] * dt;
+			y[i] += vy[i] * dt;
+			z[i] += vz[i] * dt;
+		}
+		computeAccelerations();
+		kick(0.5f * dt);
+	}
+
+	void computeAccelerations() {
+		if (method == BarnesHut) accelerationsBarnesHut();
+		else accelerationsDirect();
+		accelerationsValid = true;
+	}
+
+	//every pair, one body at a time (reference of the SSE version)
+	void accelerationsDirectScalar() {
+		parallel(size(), [this](size_t begin, size_t end) {
+			for (size_t i = begin; i < end; i++) {
+				glm::vec3 a(0.0f);
+				accumulateScalar(i, 0, size(), a);
+				ax[i] = G * a.x;
+				ay[i] = G * a.y;
+				az[i] = G * a.z;
+			}
+		});
+	}
+
+	void accelerationsDirect() {
+#ifdef NBODY_SSE
+		parallel(size(), [this](size_t begin, size_t end) {
+			size_t batched = size() & ~(size_t)3;
+			const __m128 eps2 = _mm_set1_ps(softening * softening);
+			const __m128 one = _mm_set1_ps(1.0f);
+			for (size_t i = begin; i < end; i++) {
+				__m128 xi = _mm_set1_ps(x[i]), yi = _mm_set1_ps(y[i]), zi = _mm_set1_ps(z[i]);
+				__m128 sumX = _mm_setzero_ps(), sumY = _mm_setzero_ps(), sumZ = _mm_setzero_ps();
+				for (size_t j = 0; j < batched; j += 4) {
+					__m128 dx = _mm_sub_ps(_mm_loadu_ps(&x[j]), xi);
+					__m128 dy = _mm_sub_ps(_mm_loadu_ps(&y[j]), yi);
+					__m128 dz = _mm_sub_ps(_mm_loadu_ps(&z[j]), zi);
+					__m128 r2 = _mm_add_ps(_mm_add_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dy, dy)), _mm_add_ps(_mm_mul_ps(dz, dz), eps2));
+					__m128 inverse = _mm_div_ps(one, _mm_sqrt_ps(r2));
+					//m / r^3 (the body itself has d = 0 : no contribution)
+					__m128 s = _mm_mul_ps(_mm_loadu_ps(&mass[j]), _mm_mul_ps(inverse, _mm_mul_ps(inverse, inverse)));
+					sumX = _mm_add_ps(sumX, _mm_mul_ps(s, dx));
+					sumY = _mm_add_ps(sumY, _mm_mul_ps(s, dy));
+					sumZ = _mm_add_ps(sumZ, _mm_mul_ps(s, dz));
+				}
+				glm::vec3 a(horizontalSum(sumX), horizontalSum(sumY), horizontalSum(sumZ));
+				accumulateScalar(i, batched, size(), a);
+				ax[i] = G * a.x;
+				ay[i] = G * a.y;
+				az[i] = G * a.z;
+			}
+		});
+#else
+		accelerationsDirectScalar();
+#endif
+	}
+
+	void accelerationsBarnesHut() {
+		buildTree();
+		//in Morton order : neighbouring bodies walk the same cells
+		parallel(size(), [this](size_t begin, size_t end) {
+			std::vector<int> stack;
+			for (size_t k = begin; k < end; k++) {
+				size_t i = order[k];
+				glm::vec3 a = treeAcceleration(glm::vec3(x[i], y[i], z[i]), stack);
+				ax[i] = G * a.x;
+				ay[i] = G * a.y;
+				az[i] = G * a.z;
+			}
+		});
+	}
+
+	//kinetic + potential energy (every pair : for checks on small systems)
+	double energy() const {
+		double kinetic = 0.0, potential = 0.0;
+		for (size_t i = 0; i < size(); i++) {
+			kinetic += 0.5 * mass[i] * ((double)vx[i] * vx[i] + (double)vy[i] * vy[i] + (double)vz[i] * vz[i]);
+			for (size_t j = i + 1; j < size(); j++) {
+				double dx = x[j] - x[i], dy = y[j] - y[i], dz = z[j] - z[i];
+				potential -= G * mass[i] * mass[j] / std::sqrt(dx * dx + dy * dy + dz * dz + softening * softening);
+			}
+		}
+		return kinetic + potential;
+	}
+
+	//octree cells of the last Barnes-Hut evaluation
+	size_t treeSize() const {
+		return nodes.size();
+	}
+
+private:
+	//leaves hold up to leafSize bodies, the cells stop splitting at 21 levels (Morton code of 3 x 21 bits)
+	static const int leafSize = 8;
+	static const int maxDepth = 21;
+
+	struct Node {
+		//center of mass, total mass, width of the cell
+		float cx, cy, cz, mass, size;
+		//leaf : bodies first .. first + count - 1 of the sorted arrays, otherwise children (-1 : empty octant)
+		int first, count;
+		int children[8];
+	};
+
+	bool accelerationsValid = false;
+
+	//Barnes-Hut : bodies sorted by Morton code, and the octree over them
+	std::vector<uint32_t> order;
+	std::vector<uint64_t> codes;
+	std::vector<float> sortedX, sortedY, sortedZ, sortedMass;
+	std::vector<Node> nodes;
+
+	void kick(float dt) {
+		for (size_t i = 0; i < size(); i++) {
+			vx[i] += ax[i] * dt;
+			vy[i] += ay[i] * dt;
+			vz[i] += az[i] * dt;
+		}
+	}
+
+	//sum of m d / r^3 over the bodies first .. end - 1, without G
+	void accumulateScalar(size_t i, size_t first, size_t end, glm::vec3& a) const {
+		float eps2 = softening * softening;
+		for (size_t j = first; j < end; j++) {
+			float dx = x[j] - x[i], dy = y[j] - y[i], dz = z[j] - z[i];
+			float r2 = dx * dx + dy * dy + dz * dz + eps2;
+			float inverse = 1.0f / std::sqrt(r2);
+			float s = mass[j] * inverse * inverse * inverse;
+			a += s * glm::vec3(dx, dy, dz);
+		}
+	}
+
+#ifdef NBODY_SSE
+	static float horizontalSum(__m128 v) {
+		float lanes[4];
+		_mm_storeu_ps(lanes, v);
+		return (lanes[0] + lanes[1]) + (lanes[2] + lanes[3]);
+	}
+#endif
+
+	//work(begin, end) on contiguous ranges, one per thread
+	void parallel(size_t count, const std::function<void(size_t, size_t)>& work) const {
+		size_t workers = std::max<size_t>(1, std::min<size_t>(threads, count / 64));
+		if (workers == 1) {
+			work(0, count);
+			return;
+		}
+		std::vector<std::thread> pool;
+		for (size_t t = 1; t < workers; t++) {
+			pool.emplace_back(work, count * t / workers, count * (t + 1) / workers);
+		}
+		work(0, count / workers);
+		for (std::thread& thread : pool) thread.join();
+	}
+
+	//spread the 21 low bits of v so that there are two zero bits between them
+	static uint64_t spreadBits(uint64_t v) {
+		v &= 0x1fffff;
+		v = (v | v << 32) & 0x1f00000000ffffull;
+		v = (v | v << 16) & 0x1f0000ff0000ffull;
+		v = (v | v << 8) & 0x100f00f00f00f00full;
+		v = (v | v << 4) & 0x10c30c30c30c30c3ull;
+		v = (v | v << 2) & 0x1249249249249249ull;
+		return v;
+	}
+
+	void buildTree() {
+		size_t n = size();
+		nodes.clear();
+		if (n == 0) return;
+
+		//bounding cube
+		glm::vec3 low(x[0], y[0], z[0]), high = low;
+		for (size_t i = 0; i < n; i++) {
+			low = glm::min(low, glm::vec3(x[i], y[i], z[i]));
+			high = glm::max(high, glm::vec3(x[i], y[i], z[i]));
+		}
+		float width = std::max(std::max(high.x - low.x, high.y - low.y), std::max(high.z - low.z, 1e-6f));
+
+		//Morton codes, then the bodies sorted along the curve
+		codes.resize(n);
+		order.resize(n);
+		float scale = (float)((1 << maxDepth) - 1) / width;
+		for (size_t i = 0; i < n; i++) {
+			uint64_t cx = (uint64_t)((x[i] - low.x) * scale);
+			uint64_t cy = (uint64_t)((y[i] - low.y) * scale);
+			uint64_t cz = (uint64_t)((z[i] - low.z) * scale);
+			codes[i] = spreadBits(cx) << 2 | spreadBits(cy) << 1 | spreadBits(cz);
+			order[i] = i;
+		}
+		std::sort(order.begin(), order.end(), [this](uint32_t a, uint32_t b) { return codes[a] < codes[b]; });
+
+		sortedX.resize(n);
+		sortedY.resize(n);
+		sortedZ.resize(n);
+		sortedMass.resize(n);
+		std::vector<uint64_t> sortedCodes(n);
+		for (size_t k = 0; k < n; k++) {
+			sortedX[k] = x[order[k]];
+			sortedY[k] = y[order[k]];
+			sortedZ[k] = z[order[k]];
+			sortedMass[k] = mass[order[k]];
+			sortedCodes[k] = codes[order[k]];
+		}
+		codes.swap(sortedCodes);
+
+		nodes.reserve(2 * n / leafSize + 64);
+		buildNode(0, n, 0, width);
+	}
+
+	//cell of the sorted bodies first .. end - 1 which share the first depth octants, returns its index
+	int buildNode(size_t first, size_t end, int depth, float width) {
+		int index = nodes.size();
+		nodes.push_back(Node());
+		Node node;
+		node.size = width;
+		node.first = first;
+		node.count = 0;
+		for (int c = 0; c < 8; c++) node.children[c] = -1;
+
+		if (end - first <= (size_t)leafSize || depth == maxDepth) {
+			node.count = end - first;
+			double m = 0.0, cx = 0.0, cy = 0.0, cz = 0.0;
+			for (size_t k = first; k < end; k++) {
+				m += sortedMass[k];
+				cx += (double)sortedMass[k] * sortedX[k];
+				cy += (double)sortedMass[k] * sortedY[k];
+				cz += (double)sortedMass[k] * sortedZ[k];
+			}
+			setCenter(node, m, cx, cy, cz);
+			nodes[index] = node;
+			return index;
+		}
+
+		//the octant at this depth is given by 3 bits of the code : the bodies of an octant are contiguous
+		int shift = 3 * (maxDepth - 1 - depth);
+		double m = 0.0, cx = 0.0, cy = 0.0, cz = 0.0;
+		size_t begin = first;
+		while (begin < end) {
+			int octant = (codes[begin] >> shift) & 7;
+			size_t stop = begin;
+			while (stop < end && (int)((codes[stop] >> shift) & 7) == octant) stop++;
+			int child = buildNode(begin, stop, depth + 1, 0.5f * width);
+			node.children[octant] = child;
+			const Node& c = nodes[child];
+			m += c.mass;
+			cx += (double)c.mass * c.cx;
+			cy += (double)c.mass * c.cy;
+			cz += (double)c.mass * c.cz;
+			begin = stop;
+		}
+		setCenter(node, m, cx, cy, cz);
+		nodes[index] = node;
+		return index;
+	}
+
+	static void setCenter(Node& node, double m, double cx, double cy, double cz) {
+		node.mass = m;
+		node.cx = m > 0.0 ? cx / m : 0.0f;
+		node.cy = m > 0.0 ? cy / m : 0.0f;
+		node.cz = m > 0.0 ? cz / m : 0.0f;
+	}
+
+	glm::vec3 treeAcceleration(const glm::vec3& p, std::vector<int>& stack) const {
+		float eps2 = softening * softening;
+		float theta2 = theta * theta;
+		glm::vec3 a(0.0f);
+		stack.clear();
+		stack.push_back(0);
+		while (!stack.empty()) {
+			const Node& node = nodes[stack.back()];
+			stack.pop_back();
+			float dx = node.cx - p.x, dy = node.cy - p.y, dz = node.cz - p.z;
+			float d2 = dx * dx + dy * dy + dz * dz;
+
+			if (node.count > 0) {
+				//leaf : every body (the body itself adds nothing)
+				for (int k = node.first; k < node.first + node.count; k++) {
+					float bx = sortedX[k] - p.x, by = sortedY[k] - p.y, bz = sortedZ[k] - p.z;
+					float inverse = 1.0f / std::sqrt(bx * bx + by * by + bz * bz + eps2);
+					a += sortedMass[k] * inverse * inverse * inverse * glm::vec3(bx, by, bz);
+				}
+			}
+			else if (node.size * node.size < theta2 * d2) {
+				//far enough : the whole cell at its center of mass
+				float inverse = 1.0f / std::sqrt(d2 + eps2);
+				a += node.mass * inverse * inverse * inverse * glm::vec3(dx, dy, dz);
+			}
+			else {
+				for (int c = 0; c < 8; c++) {
+					if (node.children[c] >= 0) stack.push_back(node.children[c]);
+				}
+			}
+		}
+		return a;
+	}
+};
+
+#endif
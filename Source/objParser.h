@@ -0,0 +1,500 @@
+#ifndef OBJ_PARSER_H
+#define OBJ_PARSER_H
+
+#include <iostream>
+#include <vector>
+#include <cstring>
+#include <cstdlib>
+#include <cstdint>
+#include <cfloat>
+#include <thread>
+#include <atomic>
+#include <algorithm>
+#include <functional>
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include <glm/glm.hpp>
+
+/* OBJ loading without per-line allocation :
+* the file is mapped in memory and scanned in place, numbers are read by hand
+* instead of going through istringstream/stof (locale + allocation per token)
+*/
+
+//one face corner as written in the file (position/texture/normal indices, -1 when absent)
+struct VertexKey {
+	int p, t, n;
+
+	bool operator==(const VertexKey& other) const {
+		return p == other.p && t == other.t && n == other.n;
+	}
+};
+
+struct VertexKeyHash {
+	size_t operator()(const VertexKey& key) const {
+		size_t h = (size_t)key.p * 73856093u;
+		h ^= (size_t)key.t * 19349663u;
+		h ^= (size_t)key.n * 83492791u;
+		return h;
+	}
+};
+
+//raw content of an OBJ file, faces are triangulated and their indices are 0-based
+struct ObjData {
+	std::vector<glm::vec3> positions;
+	std::vector<glm::vec2> textures;
+	std::vector<glm::vec3> normals;
+	std::vector<VertexKey> corners;
+};
+
+
+//read-only memory mapping of a whole file
+class MappedFile
+{
+public:
+	MappedFile() {}
+	MappedFile(const MappedFile&) = delete;
+	MappedFile& operator=(const MappedFile&) = delete;
+
+	~MappedFile() {
+		close();
+	}
+
+	bool open(const char* path) {
+		close();
+#ifdef _WIN32
+		file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+		if (file == INVALID_HANDLE_VALUE) {
+			return false;
+		}
+		LARGE_INTEGER fileSize;
+		GetFileSizeEx(file, &fileSize);
+		length = (size_t)fileSize.QuadPart;
+		if (length == 0) {
+			return true;
+		}
+		mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+		if (mapping == NULL) {
+			close();
+			return false;
+		}
+		bytes = (const char*)MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+#else
+		fd = ::open(path, O_RDONLY);
+		if (fd < 0) {
+			return false;
+		}
+		struct stat st;
+		fstat(fd, &st);
+		length = (size_t)st.st_size;
+		if (length == 0) {
+			return true;
+		}
+		void* view = mmap(NULL, length, PROT_READ, MAP_PRIVATE, fd, 0);
+		bytes = view == MAP_FAILED ? nullptr : (const char*)view;
+		if (bytes) {
+			madvise(view, length, MADV_SEQUENTIAL);
+		}
+#endif
+		if (!bytes) {
+			close();
+			return false;
+		}
+		return true;
+	}
+
+	void close() {
+#ifdef _WIN32
+		if (bytes) UnmapViewOfFile(bytes);
+		if (mapping != NULL) CloseHandle(mapping);
+		if (file != INVALID_HANDLE_VALUE) CloseHandle(file);
+		mapping = NULL;
+		file = INVALID_HANDLE_VALUE;
+#else
+		if (bytes) munmap((void*)bytes, length);
+		if (fd >= 0) ::close(fd);
+		fd = -1;
+#endif
+		bytes = nullptr;
+		length = 0;
+	}
+
+	const char* data() const { return bytes; }
+	size_t size() const { return length; }
+
+private:
+	const char* bytes = nullptr;
+	size_t length = 0;
+#ifdef _WIN32
+	HANDLE file = INVALID_HANDLE_VALUE;
+	HANDLE mapping = NULL;
+#else
+	int fd = -1;
+#endif
+};
+
+
+namespace objparser {
+
+	inline bool isBlank(char c) {
+		return c == ' ' || c == '\t' || c == '\r';
+	}
+
+	inline bool isDigit(char c) {
+		return c >= '0' && c <= '9';
+	}
+
+	inline void skipBlank(const char*& p, const char* end) {
+		while (p < end && isBlank(*p)) p++;
+	}
+
+	inline const char* skipLine(const char* p, const char* end) {
+		const char* eol = (const char*)memchr(p, '\n', end - p);
+		return eol ? eol + 1 : end;
+	}
+
+	//slow path : copy the token so strtof cannot run past the end of the mapping
+	inline const char* parseFloatSlow(const char* start, const char* end, float& out) {
+		char buffer[128];
+		const char* p = start;
+		size_t n = 0;
+		while (p < end && n < sizeof(buffer) - 1 && !isBlank(*p) && *p != '\n') {
+			buffer[n++] = *p++;
+		}
+		buffer[n] = '\0';
+		char* stop;
+		out = std::strtof(buffer, &stop);
+		return start + (stop - buffer);
+	}
+
+	/* Reads a float exactly as strtof would.
+	* Fast path (Clinger) : with at most 19 digits and a mantissa below 2^53, a single multiplication
+	* or division by an exact power of ten gives the correctly rounded double. Rounding that double to
+	* float is then exact unless the double lies precisely halfway between two floats, which goes to strtof.
+	*/
+	inline const char* parseFloat(const char* p, const char* end, float& out) {
+		static const double powers[] = {
+			1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+			1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+		};
+		const char* start = p;
+		bool negative = false;
+		if (p < end && (*p == '-' || *p == '+')) {
+			negative = *p == '-';
+			p++;
+		}
+
+		uint64_t mantissa = 0;
+		int digits = 0;
+		int exponent = 0;
+		bool any = false;
+		while (p < end && isDigit(*p)) {
+			if (mantissa != 0 || *p != '0') digits++;
+			mantissa = mantissa * 10 + (*p - '0');
+			p++;
+			any = true;
+		}
+		if (p < end && *p == '.') {
+			p++;
+			while (p < end && isDigit(*p)) {
+				if (mantissa != 0 || *p != '0') digits++;
+				mantissa = mantissa * 10 + (*p - '0');
+				exponent--;
+				p++;
+				any = true;
+			}
+		}
+		if (!any || digits > 19) {
+			return parseFloatSlow(start, end, out);
+		}
+		if (p < end && (*p == 'e' || *p == 'E')) {
+			const char* q = p + 1;
+			bool negativeExp = false;
+			if (q < end && (*q == '-' || *q == '+')) {
+				negativeExp = *q == '-';
+				q++;
+			}
+			if (q == end || !isDigit(*q)) {
+				return parseFloatSlow(start, end, out);
+			}
+			int e = 0;
+			while (q < end && isDigit(*q)) {
+				if (e < 10000) e = e * 10 + (*q - '0');
+				q++;
+			}
+			exponent += negativeExp ? -e : e;
+			p = q;
+		}
+
+		if (mantissa > (1ull << 53) || exponent < -22 || exponent > 22) {
+			return parseFloatSlow(start, end, out);
+		}
+		double value = (double)mantissa;
+		value = exponent < 0 ? value / powers[-exponent] : value * powers[exponent];
+
+		uint64_t bits;
+		memcpy(&bits, &value, sizeof(bits));
+		if ((bits & 0x1FFFFFFFull) == 0x10000000ull || (value != 0.0 && (value < FLT_MIN || value > FLT_MAX))) {
+			return parseFloatSlow(start, end, out);
+		}
+		out = (float)(negative ? -value : value);
+		return p;
+	}
+
+	inline const char* parseInt(const char* p, const char* end, int& out) {
+		bool negative = false;
+		if (p < end && *p == '-') {
+			negative = true;
+			p++;
+		}
+		int value = 0;
+		while (p < end && isDigit(*p)) {
+			value = value * 10 + (*p - '0');
+			p++;
+		}
+		out = negative ? -value : value;
+		return p;
+	}
+
+	/* OBJ indices are 1-based, negative ones are relative to the attributes read so far.
+	* While parsing, a relative index is replaced by (position in the list read so far) - relativeBias : it stays negative
+	* even when it points before the start of a chunk, and can later be shifted by the number of attributes read before.
+	*/
+	const int relativeBias = 1 << 30;
+
+	inline int localIndex(int index, size_t count) {
+		return index < 0 ? (int)count + index - relativeBias : index;
+	}
+
+	inline int resolveIndex(int index, size_t base) {
+		if (index > 0) return index - 1;
+		if (index < 0) return (int)base + index + relativeBias;
+		return -1;
+	}
+
+	//parse "p", "p/t", "p//n" or "p/t/n"
+	inline const char* parseCorner(const char* p, const char* end, VertexKey& key) {
+		key.p = key.t = key.n = 0;
+		p = parseInt(p, end, key.p);
+		if (p < end && *p == '/') {
+			p++;
+			if (p < end && *p != '/') p = parseInt(p, end, key.t);
+			if (p < end && *p == '/') {
+				p++;
+				p = parseInt(p, end, key.n);
+			}
+		}
+		return p;
+	}
+
+	//parse the records of [p, end) and append them to data ; indices are left as written in the file
+	inline void parseRecords(const char* p, const char* end, ObjData& data) {
+		while (p < end) {
+			skipBlank(p, end);
+			if (p + 1 < end && p[0] == 'v' && isBlank(p[1])) {
+				glm::vec3 v;
+				p += 2;
+				skipBlank(p, end); p = parseFloat(p, end, v.x);
+				skipBlank(p, end); p = parseFloat(p, end, v.y);
+				skipBlank(p, end); p = parseFloat(p, end, v.z);
+				data.positions.push_back(v);
+			}
+			else if (p + 2 < end && p[0] == 'v' && p[1] == 'n' && isBlank(p[2])) {
+				glm::vec3 n;
+				p += 3;
+				skipBlank(p, end); p = parseFloat(p, end, n.x);
+				skipBlank(p, end); p = parseFloat(p, end, n.y);
+				skipBlank(p, end); p = parseFloat(p, end, n.z);
+				data.normals.push_back(n);
+			}
+			else if (p + 2 < end && p[0] == 'v' && p[1] == 't' && isBlank(p[2])) {
+				glm::vec2 t;
+				p += 3;
+				skipBlank(p, end); p = parseFloat(p, end, t.x);
+				skipBlank(p, end); p = parseFloat(p, end, t.y);
+				data.textures.push_back(t);
+			}
+			else if (p + 1 < end && p[0] == 'f' && isBlank(p[1])) {
+				//polygons are split in a triangle fan around their first corner
+				VertexKey first, previous, current;
+				int count = 0;
+				p += 2;
+				skipBlank(p, end);
+				while (p < end && (isDigit(*p) || *p == '-')) {
+					p = parseCorner(p, end, current);
+					current.p = localIndex(current.p, data.positions.size());
+					current.t = localIndex(current.t, data.textures.size());
+					current.n = localIndex(current.n, data.normals.size());
+					if (count >= 2) {
+						data.corners.push_back(first);
+						data.corners.push_back(previous);
+						data.corners.push_back(current);
+					}
+					if (count == 0) first = current;
+					previous = current;
+					count++;
+					skipBlank(p, end);
+				}
+			}
+			p = skipLine(p, end);
+		}
+	}
+
+	//first corner whose indices point outside the attribute lists (the texture and normal are optional : -1), corners.size() if none
+	inline size_t findInvalidCorner(const ObjData& data) {
+		for (size_t i = 0; i < data.corners.size(); i++) {
+			const VertexKey& key = data.corners[i];
+			if (key.p < 0 || key.p >= (int)data.positions.size()
+				|| key.t < -1 || key.t >= (int)data.textures.size()
+				|| key.n < -1 || key.n >= (int)data.normals.size()) {
+				return i;
+			}
+		}
+		return data.corners.size();
+	}
+
+	//line (from 1) of the face that gave the triangle, found again by counting the triangles of every face
+	inline size_t faceLine(const char* p, const char* end, size_t triangle) {
+		size_t line = 1, triangles = 0;
+		while (p < end) {
+			skipBlank(p, end);
+			if (p + 1 < end && p[0] == 'f' && isBlank(p[1])) {
+				VertexKey corner;
+				size_t count = 0;
+				p += 2;
+				skipBlank(p, end);
+				while (p < end && (isDigit(*p) || *p == '-')) {
+					p = parseCorner(p, end, corner);
+					count++;
+					skipBlank(p, end);
+				}
+				if (count >= 2) triangles += count - 2;
+				if (triangles > triangle) return line;
+			}
+			p = skipLine(p, end);
+			line++;
+		}
+		return line;
+	}
+
+	//turn the indices of corners [first, last) into 0-based ones, relative indices are shifted by the given bases
+	inline void resolveCorners(ObjData& data, size_t first, size_t last, size_t positionBase, size_t textureBase, size_t normalBase) {
+		for (size_t i = first; i < last; i++) {
+			VertexKey& key = data.corners[i];
+			key.p = resolveIndex(key.p, positionBase);
+			key.t = resolveIndex(key.t, textureBase);
+			key.n = resolveIndex(key.n, normalBase);
+		}
+	}
+}
+
+//parse a whole OBJ buffer
+inline void parseObj(const char* bytes, size_t size, ObjData& data) {
+	objparser::parseRecords(bytes, bytes + size, data);
+	objparser::resolveCorners(data, 0, data.corners.size(), 0, 0, 0);
+}
+
+/* Parallel parse :
+* the buffer is cut into chunks at line boundaries, each chunk is parsed by a pool of threads into its own ObjData,
+* then a prefix sum over the attribute counts gives where each chunk goes in the final arrays
+* and the base to add to its relative indices. The result is the same as parseObj, bit for bit.
+*/
+inline void parseObjParallel(const char* bytes, size_t size, ObjData& data, unsigned threads) {
+	const size_t minChunkSize = 1 << 20;
+	size_t chunkCount = std::min<size_t>(threads * 4, size / minChunkSize);
+	if (threads <= 1 || chunkCount <= 1) {
+		parseObj(bytes, size, data);
+		return;
+	}
+
+	const char* end = bytes + size;
+	std::vector<const char*> bounds(chunkCount + 1);
+	bounds[0] = bytes;
+	for (size_t i = 1; i < chunkCount; i++) {
+		const char* cut = std::max(bytes + size * i / chunkCount, bounds[i - 1]);
+		bounds[i] = cut == bytes ? cut : objparser::skipLine(cut - 1, end);
+	}
+	bounds[chunkCount] = end;
+
+	//a minimal pool : every worker takes the next chunk until there is none left
+	std::vector<ObjData> chunks(chunkCount);
+	auto runPool = [&](const std::function<void(size_t)>& job) {
+		std::atomic<size_t> next(0);
+		auto worker = [&]() {
+			for (size_t i = next++; i < chunkCount; i = next++) {
+				job(i);
+			}
+		};
+		std::vector<std::thread> pool;
+		for (unsigned t = 1; t < std::min<size_t>(threads, chunkCount); t++) {
+			pool.emplace_back(worker);
+		}
+		worker();
+		for (std::thread& thread : pool) {
+			thread.join();
+		}
+	};
+
+	runPool([&](size_t i) {
+		objparser::parseRecords(bounds[i], bounds[i + 1], chunks[i]);
+	});
+
+	//exclusive prefix sums of the per-chunk counts
+	std::vector<size_t> positionBase(chunkCount + 1, 0), textureBase(chunkCount + 1, 0);
+	std::vector<size_t> normalBase(chunkCount + 1, 0), cornerBase(chunkCount + 1, 0);
+	for (size_t i = 0; i < chunkCount; i++) {
+		positionBase[i + 1] = positionBase[i] + chunks[i].positions.size();
+		textureBase[i + 1] = textureBase[i] + chunks[i].textures.size();
+		normalBase[i + 1] = normalBase[i] + chunks[i].normals.size();
+		cornerBase[i + 1] = cornerBase[i] + chunks[i].corners.size();
+	}
+
+	data.positions.resize(positionBase[chunkCount]);
+	data.textures.resize(textureBase[chunkCount]);
+	data.normals.resize(normalBase[chunkCount]);
+	data.corners.resize(cornerBase[chunkCount]);
+
+	runPool([&](size_t i) {
+		ObjData& chunk = chunks[i];
+		objparser::resolveCorners(chunk, 0, chunk.corners.size(), positionBase[i], textureBase[i], normalBase[i]);
+		std::copy(chunk.positions.begin(), chunk.positions.end(), data.positions.begin() + positionBase[i]);
+		std::copy(chunk.textures.begin(), chunk.textures.end(), data.textures.begin() + textureBase[i]);
+		std::copy(chunk.normals.begin(), chunk.normals.end(), data.normals.begin() + normalBase[i]);
+		std::copy(chunk.corners.begin(), chunk.corners.end(), data.corners.begin() + cornerBase[i]);
+		chunk = ObjData();
+	});
+}
+
+//map the file and parse it (threads = 0 : one per hardware thread), returns false if the file cannot be opened
+//or if a face uses a vertex, texture coordinate or normal that does not exist
+inline bool loadObj(const char* path, ObjData& data, unsigned threads = 0) {
+	MappedFile file;
+	if (!file.open(path)) {
+		std::cout << "ERROR::OBJ::FILE_NOT_SUCCESFULLY_READ: " << path << std::endl;
+		return false;
+	}
+	if (threads == 0) {
+		threads = std::max(1u, std::thread::hardware_concurrency());
+	}
+	parseObjParallel(file.data(), file.size(), data, threads);
+
+	size_t invalid = objparser::findInvalidCorner(data);
+	if (invalid < data.corners.size()) {
+		std::cout << "ERROR::OBJ::INDEX_OUT_OF_RANGE: " << path << ":" << objparser::faceLine(file.data(), file.data() + file.size(), invalid / 3) << std::endl;
+		data = ObjData();
+		return false;
+	}
+	return true;
+}
+
+#endif
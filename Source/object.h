@@ -2,10 +2,11 @@
 #define OBJECT_H
 
 #include<iostream>
-#include <fstream>
 #include <string>
-#include <sstream>
 #include <vector>
+#include <memory>
+#include <cstddef>
+#include <algorithm>
 
 
 #include <glad/glad.h>
@@ -13,6 +14,11 @@
 
 #include <glm/glm.hpp>
 #include<glm/gtc/matrix_transform.hpp>
+#include<glm/gtc/matrix_inverse.hpp>
+
+#include "mesh.h"
+#include "glState.h"
+#include "frustum.h"
 
 
 /*Principe :
@@ -24,182 +30,203 @@
 * en gros sotck les data dans une frome de tableau
 */
 
-struct Vertex {
-	glm::vec3 Position;
-	glm::vec2 Texture;
-	glm::vec3 Normal;
+//per-instance data of makeInstances
+struct InstanceData {
+	glm::mat4 M;
+	glm::mat4 itM;
 };
 
 
+/* Object : one mesh (shared with the other objects loading the same file) placed in the scene.
+* The geometry comes from the MeshRegistry, the object only owns its transform and its instances.
+* It draws with the VAO of the mesh (the pool's when the mesh is in a GeometryPool), valid with any shader,
+* except an instanced object : its VAO also reads the instance buffer.
+*/
 class Object
 {
 public:
-	std::vector<glm::vec3> positions;
-	std::vector<glm::vec2> textures;
-	std::vector<glm::vec3> normals;
-	std::vector<Vertex> vertices;
+	std::shared_ptr<Mesh> mesh;
 
-	int numVertices;
+	GLuint VAO = 0;
+	//false : VAO belongs to the mesh or its geometry pool
+	bool ownsVAO = false;
 
-	GLuint VBO, VAO;
+	//instancing : one (M, itM) pair per instance, see makeInstances
+	GLuint instanceVBO = 0;
+	int numInstances = 0;
+	//generation of the geometry pool when VAO was bound to its buffers
+	int poolGeneration = 0;
 
 	glm::mat4 model = glm::mat4(1.0);
 
+	//level of detail drawn (0 : full mesh), see selectLod
+	int lod = 0;
 
-	Object(const char* path) {
-
-		std::ifstream infile(path);
-		//TODO Error management
-		std::string line;
-		while (std::getline(infile, line))
-		{
-			std::istringstream iss(line);
-			std::string indice;
-			iss >> indice;
-			//std::cout << "indice : " << indice << std::endl;
-			if (indice == "v") {
-				float x, y, z;
-				iss >> x >> y >> z;
-				positions.push_back(glm::vec3(x, y, z));
 
-			}
-			else if (indice == "vn") {
-				float x, y, z;
-				iss >> x >> y >> z;
-				normals.push_back(glm::vec3(x, y, z));
-			}
-			else if (indice == "vt") {
-				float u, v;
-				iss >> u >> v;
-				textures.push_back(glm::vec2(u, v));
-			}
-			else if (indice == "f") {
-				std::string f1, f2, f3;
-				iss >> f1 >> f2 >> f3;
-
-				std::string p, t, n;
-
-				//for face 1
-				Vertex v1;
-
-				p = f1.substr(0, f1.find("/"));
-				f1.erase(0, f1.find("/") + 1);
-
-				t = f1.substr(0, f1.find("/"));
-				f1.erase(0, f1.find("/") + 1);
+	Object(const char* path, bool indexed = true, VertexFormat format = VertexFormat::Float) : mesh(meshRegistry().load(path, indexed, format)) {
+	}
 
-				n = f1.substr(0, f1.find("/"));
+	//model matrix for the shader : the packed positions are decoded first
+	glm::mat4 shaderModel() const {
+		return shaderModel(model);
+	}
 
+	//same for another placement of the mesh (an instance)
+	glm::mat4 shaderModel(const glm::mat4& world) const {
+		return world * mesh->decode;
+	}
 
-				v1.Position = positions.at(std::stof(p) - 1);
-				v1.Normal = normals.at(std::stof(n) - 1);
-				v1.Texture = textures.at(std::stof(t) - 1);
-				vertices.push_back(v1);
+	//the VAO and the instance buffer are owned : no copy
+	Object(const Object&) = delete;
+	Object& operator=(const Object&) = delete;
 
-				//for face 12
-				Vertex v2;
+	~Object() {
+		if (VAO && ownsVAO) {
+			//the name may be reused by a later VAO : do not leave it in the state cache
+			glState().bindVertexArray(0);
+			glDeleteVertexArrays(1, &VAO);
+		}
+		if (instanceVBO) glDeleteBuffers(1, &instanceVBO);
+	}
 
-				p = f2.substr(0, f2.find("/"));
-				f2.erase(0, f2.find("/") + 1);
+	//bounding volumes of the mesh placed with model
+	BoundingSphere worldSphere() const {
+		return transformSphere(mesh->bounds, model);
+	}
 
-				t = f2.substr(0, f2.find("/"));
-				f2.erase(0, f2.find("/") + 1);
+	void worldBounds(glm::vec3& worldMin, glm::vec3& worldMax) const {
+		transformBounds(mesh->boundsMin, mesh->boundsMax, model, worldMin, worldMax);
+	}
 
-				n = f2.substr(0, f2.find("/"));
+	//the sphere first (cheaper), then the box for the objects it keeps
+	bool isVisible(const Frustum& frustum) const {
+		if (!frustum.intersects(worldSphere())) return false;
+		glm::vec3 worldMin, worldMax;
+		worldBounds(worldMin, worldMax);
+		return frustum.intersects(worldMin, worldMax);
+	}
 
+	/* Pick the level of detail from the size of the object on screen : pixelScale is projection[1][1] * viewport height / 2,
+	* the pixels covered by one unit at distance 1. The nearest point of the bounding sphere gives the distance.
+	*/
+	int selectLod(const glm::vec3& eye, float pixelScale, float threshold = 1.0f) {
+		BoundingSphere sphere = worldSphere();
+		float distance = std::max(glm::length(sphere.center - eye) - sphere.radius, 1e-3f);
+		float scale = mesh->bounds.radius > 0.0f ? sphere.radius / mesh->bounds.radius : 1.0f;
+		lod = chooseLod(mesh->lods, lod, scale * pixelScale / distance, threshold);
+		return lod;
+	}
 
-				v2.Position = positions.at(std::stof(p) - 1);
-				v2.Normal = normals.at(std::stof(n) - 1);
-				v2.Texture = textures.at(std::stof(t) - 1);
-				vertices.push_back(v2);
+	//triangles of one draw at the current level of detail
+	int triangles() const {
+		return mesh->lods[lod].indexCount / 3;
+	}
 
-				//for face 3
-				Vertex v3;
+	//write (or refresh) the binary cache of an OBJ without any OpenGL context
+	static void bakeCache(const char* path) {
+		Mesh::bakeCache(path);
+	}
 
-				p = f3.substr(0, f3.find("/"));
-				f3.erase(0, f3.find("/") + 1);
+	//upload the mesh (the first object using it does) and draw with its VAO
+	void makeObject() {
+		mesh->upload();
+		VAO = mesh->VAO;
+		ownsVAO = false;
+	}
 
-				t = f3.substr(0, f3.find("/"));
-				f3.erase(0, f3.find("/") + 1);
+	/* Per-instance model and inverse-transpose matrices, read by the instance_M / instance_itM inputs
+	* of the shader (see vertexLayout.h). To call after makeObject.
+	*/
+	void makeInstances(const std::vector<glm::mat4>& models) {
+		//the instance buffer is part of the VAO : the one of the mesh cannot take it
+		VAO = createVertexArray(mesh->format, mesh->vertexBuffer(), mesh->indexBuffer());
+		ownsVAO = true;
+		if (mesh->pool) poolGeneration = mesh->pool->generation();
+		glGenBuffers(1, &instanceVBO);
+
+		glState().bindVertexArray(VAO);
+		for (int column = 0; column < 4; column++) {
+			glEnableVertexAttribArray(attribute::instanceM + column);
+			glVertexAttribFormat(attribute::instanceM + column, 4, GL_FLOAT, false, offsetof(InstanceData, M) + column * sizeof(glm::vec4));
+			glVertexAttribBinding(attribute::instanceM + column, instanceBinding);
+
+			glEnableVertexAttribArray(attribute::instanceItM + column);
+			glVertexAttribFormat(attribute::instanceItM + column, 4, GL_FLOAT, false, offsetof(InstanceData, itM) + column * sizeof(glm::vec4));
+			glVertexAttribBinding(attribute::instanceItM + column, instanceBinding);
+		}
+		//one element per instance
+		glVertexBindingDivisor(instanceBinding, 1);
+		glBindVertexBuffer(instanceBinding, instanceVBO, 0, sizeof(InstanceData));
+		glState().bindVertexArray(0);
 
-				n = f3.substr(0, f3.find("/"));
+		updateInstances(models);
+	}
 
+	//replace the instance transforms (the buffer is orphaned, the GPU can still read the previous one)
+	void updateInstances(const std::vector<glm::mat4>& models) {
+		std::vector<InstanceData> instances(models.size());
+		for (size_t i = 0; i < models.size(); i++) {
+			instances[i].M = models[i];
+			instances[i].itM = glm::inverseTranspose(models[i]);
+		}
+		updateInstances(instances);
+	}
 
-				v3.Position = positions.at(std::stof(p) - 1);
-				v3.Normal = normals.at(std::stof(n) - 1);
-				v3.Texture = textures.at(std::stof(t) - 1);
-				vertices.push_back(v3);
+	//same with the inverse-transposes already known (M places the mesh, the packed positions are decoded here)
+	void updateInstances(const std::vector<InstanceData>& instances) {
+		numInstances = instances.size();
+
+		glBindBuffer(GL_ARRAY_BUFFER, instanceVBO);
+		glBufferData(GL_ARRAY_BUFFER, sizeof(InstanceData) * numInstances, nullptr, GL_STREAM_DRAW);
+		if (numInstances > 0) {
+			InstanceData* mapped = (InstanceData*)glMapBufferRange(GL_ARRAY_BUFFER, 0, sizeof(InstanceData) * numInstances, GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT);
+			if (mapped) {
+				for (int i = 0; i < numInstances; i++) {
+					mapped[i].M = shaderModel(instances[i].M);
+					mapped[i].itM = instances[i].itM;
+				}
+				glUnmapBuffer(GL_ARRAY_BUFFER);
+			}
+			else {
+				std::cout << "Could not map the instance buffer" << std::endl;
+				numInstances = 0;
 			}
 		}
-		//std::cout << positions.size() << std::endl;
-		//std::cout << normals.size() << std::endl;
-		//std::cout << textures.size() << std::endl;
-		std::cout << "Load model with " << vertices.size() << " vertices" << std::endl;
-
-		infile.close();
-
-		numVertices = vertices.size();
+		glBindBuffer(GL_ARRAY_BUFFER, 0);
 	}
 
+	//draw every instance in one call
+	void drawInstanced() {
 
-
-	void makeObject(Shader shader, bool texture = true) {
-		/* This is a working but not perfect solution, you can improve it if you need/want
-		* What happens if you call this function twice on an Model ?
-		* What happens when a shader doesn't have a position, tex_coord or normal attribute ?
-		*/
-
-		float* data = new float[8 * numVertices];
-		for (int i = 0; i < numVertices; i++) {
-			Vertex v = vertices.at(i);
-			data[i * 8] = v.Position.x;
-			data[i * 8 + 1] = v.Position.y;
-			data[i * 8 + 2] = v.Position.z;
-
-			data[i * 8 + 3] = v.Texture.x;
-			data[i * 8 + 4] = v.Texture.y;
-
-			data[i * 8 + 5] = v.Normal.x;
-			data[i * 8 + 6] = v.Normal.y;
-			data[i * 8 + 7] = v.Normal.z;
+		const MeshLod& range = mesh->lods[lod];
+		glState().bindVertexArray(this->VAO);
+		//the pool has grown since makeInstances : its buffers were replaced
+		if (mesh->pool && mesh->pool->generation() != poolGeneration) {
+			glBindVertexBuffer(vertexBinding, mesh->vertexBuffer(), 0, vertexStride(mesh->format));
+			glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, mesh->indexBuffer());
+			poolGeneration = mesh->pool->generation();
 		}
-
-		glGenVertexArrays(1, &VAO);
-		glGenBuffers(1, &VBO);
-
-		//define VBO and VAO as active buffer and active vertex array
-		glBindVertexArray(VAO);
-		glBindBuffer(GL_ARRAY_BUFFER, VBO);
-		glBufferData(GL_ARRAY_BUFFER, sizeof(Vertex) * numVertices, data, GL_STATIC_DRAW);
-
-		auto att_pos = glGetAttribLocation(shader.ID, "position");
-		glEnableVertexAttribArray(att_pos);
-		glVertexAttribPointer(att_pos, 3, GL_FLOAT, false, 8 * sizeof(float), (void*)0);
-
-		
-		if (texture) {
-			auto att_tex = glGetAttribLocation(shader.ID, "tex_coord");
-			glEnableVertexAttribArray(att_tex);
-			glVertexAttribPointer(att_tex, 2, GL_FLOAT, false, 8 * sizeof(float), (void*)(3 * sizeof(float)));
-			
+		if (mesh->indexed) {
+			glDrawElementsInstancedBaseVertex(GL_TRIANGLES, range.indexCount, GL_UNSIGNED_INT, (void*)(sizeof(GLuint) * (mesh->firstIndex + range.firstIndex)), numInstances, mesh->baseVertex);
+		}
+		else {
+			glDrawArraysInstanced(GL_TRIANGLES, 0, mesh->numVertices, numInstances);
 		}
-		
-		auto att_col = glGetAttribLocation(shader.ID, "normal");
-		glEnableVertexAttribArray(att_col);
-		glVertexAttribPointer(att_col, 3, GL_FLOAT, false, 8 * sizeof(float), (void*)(5 * sizeof(float)));
-		
-		//desactive the buffer
-		glBindBuffer(GL_ARRAY_BUFFER, 0);
-		glBindVertexArray(0);
-		delete[] data;
 
 	}
 
 	void draw() {
 
-		glBindVertexArray(this->VAO);
-		glDrawArrays(GL_TRIANGLES, 0, numVertices);
+		const MeshLod& range = mesh->lods[lod];
+		glState().bindVertexArray(this->VAO);
+		if (mesh->indexed) {
+			glDrawElementsBaseVertex(GL_TRIANGLES, range.indexCount, GL_UNSIGNED_INT, (void*)(sizeof(GLuint) * (mesh->firstIndex + range.firstIndex)), mesh->baseVertex);
+		}
+		else {
+			glDrawArrays(GL_TRIANGLES, 0, mesh->numVertices);
+		}
 
 	}
+
 };
 #endif
\ No newline at end of file
@@ -0,0 +1,261 @@
+#ifndef PROFILER_H
+#define PROFILER_H
+
+#include<iostream>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <chrono>
+#include <algorithm>
+#include <cstdint>
+
+#include <glad/glad.h>
+
+/* Frame profiler with named zones (planet, moon, skybox, ...) :
+* - CPU time of a zone with a steady clock,
+* - GPU time with a GL_TIME_ELAPSED query. The queries are double buffered : the result of a frame
+*   is read two frames later, when its query objects are reused, so the CPU never waits for the GPU.
+* The last frames are kept in a ring buffer, for the percentiles of report() and the exports.
+* Zones can not overlap (one GL_TIME_ELAPSED query at a time).
+*/
+class Profiler
+{
+public:
+	static const int maxZones = 16;
+	//sets of queries in flight
+	static const int latency = 2;
+
+	struct FrameRecord {
+		long long frame = -1;
+		//start of the frame since the creation of the profiler, and duration (CPU, frame to frame), ms
+		double start = 0.0;
+		double duration = 0.0;
+		//per zone, ms (gpu < 0 : result not available)
+		double cpuStart[maxZones];
+		double cpu[maxZones];
+		double gpu[maxZones];
+	};
+
+	explicit Profiler(size_t capacity = 1024, bool gpuTimers = true) : records(capacity), gpuTimers(gpuTimers) {
+		origin = std::chrono::steady_clock::now();
+		if (gpuTimers) {
+			glGenQueries(latency * maxZones, &queries[0][0]);
+		}
+	}
+
+	Profiler(const Profiler&) = delete;
+	Profiler& operator=(const Profiler&) = delete;
+
+	~Profiler() {
+		if (gpuTimers) {
+			glDeleteQueries(latency * maxZones, &queries[0][0]);
+		}
+	}
+
+	//register a zone once, returns the handle to give to begin / end
+	int zone(const char* name) {
+		if ((int)names.size() == maxZones) {
+			std::cout << "Too many profiler zones, " << name << " is ignored" << std::endl;
+			return -1;
+		}
+		names.push_back(name);
+		return names.size() - 1;
+	}
+
+	void beginFrame() {
+		double now = elapsed();
+		if (frame >= 0) {
+			record(frame).duration = now - record(frame).start;
+		}
+		frame++;
+
+		//the queries of this set were issued latency frames ago
+		if (gpuTimers) collect(frame - latency);
+
+		FrameRecord& current = record(frame);
+		current.frame = frame;
+		current.start = now;
+		current.duration = 0.0;
+		for (int i = 0; i < maxZones; i++) {
+			current.cpuStart[i] = 0.0;
+			current.cpu[i] = 0.0;
+			current.gpu[i] = -1.0;
+			issued[frame % latency][i] = false;
+		}
+	}
+
+	void begin(int id) {
+		if (id < 0 || frame < 0) return;
+		record(frame).cpuStart[id] = elapsed();
+		if (gpuTimers) {
+			glBeginQuery(GL_TIME_ELAPSED, queries[frame % latency][id]);
+			issued[frame % latency][id] = true;
+		}
+	}
+
+	void end(int id) {
+		if (id < 0 || frame < 0) return;
+		if (gpuTimers) glEndQuery(GL_TIME_ELAPSED);
+		FrameRecord& current = record(frame);
+		current.cpu[id] += elapsed() - current.cpuStart[id];
+	}
+
+	//close the last frame and wait for the GPU times still in flight (before report / export)
+	void finish() {
+		if (frame < 0) return;
+		record(frame).duration = elapsed() - record(frame).start;
+		for (long long previous = frame - latency + 1; previous <= frame; previous++) {
+			if (gpuTimers) collect(previous);
+		}
+		frame++;
+		record(frame).frame = -1;
+	}
+
+	//frames still in the ring buffer, oldest first (the frame in progress is excluded)
+	std::vector<const FrameRecord*> history() const {
+		std::vector<const FrameRecord*> frames;
+		for (size_t i = 0; i < records.size(); i++) {
+			const FrameRecord& r = records[(frame + 1 + i) % records.size()];
+			if (r.frame >= 0 && r.frame < frame) frames.push_back(&r);
+		}
+		return frames;
+	}
+
+	//p50 / p95 / p99 of the frame time, p50 / p95 of each zone
+	void report() const {
+		std::vector<const FrameRecord*> frames = history();
+		if (frames.empty()) return;
+
+		std::vector<double> times;
+		for (const FrameRecord* r : frames) times.push_back(r->duration);
+		std::cout << std::endl << "Frame time over " << frames.size() << " frames : p50 " << percentile(times, 0.50)
+			<< " ms, p95 " << percentile(times, 0.95) << " ms, p99 " << percentile(times, 0.99) << " ms" << std::endl;
+
+		for (size_t z = 0; z < names.size(); z++) {
+			std::vector<double> cpu, gpu;
+			for (const FrameRecord* r : frames) {
+				cpu.push_back(r->cpu[z]);
+				if (r->gpu[z] >= 0.0) gpu.push_back(r->gpu[z]);
+			}
+			//zone never entered (e.g. no asteroid belt)
+			if (gpu.empty() && *std::max_element(cpu.begin(), cpu.end()) == 0.0) continue;
+			std::cout << "  " << names[z] << " : CPU p50 " << percentile(cpu, 0.50) << " ms p95 " << percentile(cpu, 0.95) << " ms";
+			if (!gpu.empty()) {
+				std::cout << ", GPU p50 " << percentile(gpu, 0.50) << " ms p95 " << percentile(gpu, 0.95) << " ms";
+			}
+			std::cout << std::endl;
+		}
+	}
+
+	//one line per frame : frame, start, duration then cpu and gpu time of every zone (ms, empty if unknown)
+	bool exportCSV(const char* path) const {
+		std::ofstream file(path);
+		if (!file) {
+			std::cout << "Could not write profile " << path << std::endl;
+			return false;
+		}
+		file << "frame,start_ms,frame_ms";
+		for (const std::string& name : names) file << "," << name << "_cpu_ms," << name << "_gpu_ms";
+		file << "\n";
+		for (const FrameRecord* r : history()) {
+			file << r->frame << "," << r->start << "," << r->duration;
+			for (size_t z = 0; z < names.size(); z++) {
+				file << "," << r->cpu[z] << ",";
+				if (r->gpu[z] >= 0.0) file << r->gpu[z];
+			}
+			file << "\n";
+		}
+		return true;
+	}
+
+	/* Trace event format, to open in chrome://tracing (or ui.perfetto.dev).
+	* Thread 1 : the frames and the CPU zones. Thread 2 : the GPU zones, placed one after the other
+	* from the start of their frame (GL_TIME_ELAPSED gives durations, not timestamps).
+	*/
+	bool exportTrace(const char* path) const {
+		std::ofstream file(path);
+		if (!file) {
+			std::cout << "Could not write profile " << path << std::endl;
+			return false;
+		}
+		file << "{\"traceEvents\":[\n";
+		file << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":1,\"args\":{\"name\":\"CPU\"}},\n";
+		file << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":2,\"args\":{\"name\":\"GPU\"}}";
+		for (const FrameRecord* r : history()) {
+			traceEvent(file, "frame", 1, r->start, r->duration);
+			double gpuTime = r->start;
+			for (size_t z = 0; z < names.size(); z++) {
+				if (r->cpu[z] > 0.0) traceEvent(file, names[z], 1, r->cpuStart[z], r->cpu[z]);
+				if (r->gpu[z] >= 0.0) {
+					traceEvent(file, names[z], 2, gpuTime, r->gpu[z]);
+					gpuTime += r->gpu[z];
+				}
+			}
+		}
+		file << "\n]}\n";
+		return true;
+	}
+
+private:
+	std::vector<std::string> names;
+	std::vector<FrameRecord> records;
+	long long frame = -1;
+	std::chrono::steady_clock::time_point origin;
+
+	bool gpuTimers;
+	GLuint queries[latency][maxZones];
+	bool issued[latency][maxZones] = {};
+
+	FrameRecord& record(long long index) {
+		return records[index % records.size()];
+	}
+
+	double elapsed() const {
+		return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - origin).count();
+	}
+
+	//read the GPU times of a frame (blocks if the GPU has not finished it)
+	void collect(long long previous) {
+		if (previous < 0) return;
+		int set = previous % latency;
+		FrameRecord& r = record(previous);
+		for (int i = 0; i < maxZones; i++) {
+			if (!issued[set][i]) continue;
+			GLuint64 nanoseconds = 0;
+			glGetQueryObjectui64v(queries[set][i], GL_QUERY_RESULT, &nanoseconds);
+			//the ring may already hold a more recent frame
+			if (r.frame == previous) r.gpu[i] = nanoseconds / 1e6;
+			issued[set][i] = false;
+		}
+	}
+
+	static double percentile(std::vector<double> values, double p) {
+		if (values.empty()) return 0.0;
+		size_t rank = std::min(values.size() - 1, (size_t)(p * (values.size() - 1) + 0.5));
+		std::nth_element(values.begin(), values.begin() + rank, values.end());
+		return values[rank];
+	}
+
+	static void traceEvent(std::ofstream& file, const std::string& name, int thread, double start, double duration) {
+		//trace timestamps are in microseconds
+		file << ",\n{\"name\":\"" << name << "\",\"ph\":\"X\",\"pid\":1,\"tid\":" << thread
+			<< ",\"ts\":" << start * 1000.0 << ",\"dur\":" << duration * 1000.0 << "}";
+	}
+};
+
+//times the enclosing scope
+class ProfileZone
+{
+public:
+	ProfileZone(Profiler& profiler, int id) : profiler(profiler), id(id) {
+		profiler.begin(id);
+	}
+	~ProfileZone() {
+		profiler.end(id);
+	}
+private:
+	Profiler& profiler;
+	int id;
+};
+
+#endif
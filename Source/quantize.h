@@ -0,0 +1,85 @@
+#ifndef QUANTIZE_H
+#define QUANTIZE_H
+
+#include <vector>
+#include <algorithm>
+#include <cstdint>
+#include <cmath>
+
+#include <glm/glm.hpp>
+#include <glm/gtc/packing.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+
+/* Compact vertex layout, 16 bytes instead of 32 :
+* - position : 3 x 16 bit unsigned normalized, relative to the bounding box of the mesh. The attribute reads it in [0, 1],
+*   decodeMatrix() maps it back to model space and is folded into the model matrix (the shaders are unchanged).
+* - texture coordinate : 2 x half float (any range, about 1/2048 of precision near 1)
+* - normal : 10:10:10:2 signed normalized (GL_INT_2_10_10_10_REV), the 2 bit w is unused
+* The normals and texture coordinates need no decoding : the normal matrix of the object stays the same.
+*/
+
+struct PackedVertex {
+	uint16_t Position[3];
+	uint16_t padding;
+	uint16_t Texture[2];
+	uint32_t Normal;
+};
+//setVertexFormat (vertexLayout.h) relies on this layout
+static_assert(sizeof(PackedVertex) == 16, "PackedVertex must be tightly packed");
+
+//largest differences between the float mesh and its packed vertices
+struct QuantizationError {
+	//model units, and fraction of the largest side of the box
+	float position;
+	float relativePosition;
+	//degrees
+	float normal;
+	float texture;
+};
+
+//packed [0, 1] -> model space
+inline glm::mat4 decodeMatrix(const glm::vec3& boundsMin, const glm::vec3& boundsMax) {
+	glm::vec3 extent = glm::max(boundsMax - boundsMin, glm::vec3(1e-20f));
+	return glm::scale(glm::translate(glm::mat4(1.0f), boundsMin), extent);
+}
+
+//V has Position, Texture and Normal members (Vertex of mesh.h)
+template<typename V>
+QuantizationError packVertices(const V* vertices, size_t count, const glm::vec3& boundsMin, const glm::vec3& boundsMax, std::vector<PackedVertex>& packed) {
+	glm::vec3 extent = glm::max(boundsMax - boundsMin, glm::vec3(1e-20f));
+	QuantizationError error = { 0.0f, 0.0f, 0.0f, 0.0f };
+	float maxCosine = 1.0f;
+	packed.resize(count);
+	for (size_t i = 0; i < count; i++) {
+		const V& v = vertices[i];
+		PackedVertex& p = packed[i];
+		glm::vec3 unit = glm::clamp((v.Position - boundsMin) / extent, 0.0f, 1.0f);
+		glm::vec3 decoded;
+		for (int k = 0; k < 3; k++) {
+			p.Position[k] = glm::packUnorm1x16(unit[k]);
+			decoded[k] = boundsMin[k] + glm::unpackUnorm1x16(p.Position[k]) * extent[k];
+		}
+		p.padding = 0;
+		error.position = std::max(error.position, glm::length(decoded - v.Position));
+
+		for (int k = 0; k < 2; k++) {
+			p.Texture[k] = glm::packHalf1x16(v.Texture[k]);
+			error.texture = std::max(error.texture, std::abs(glm::unpackHalf1x16(p.Texture[k]) - v.Texture[k]));
+		}
+
+		//a zero normal (the OBJ had none) stays zero
+		float length = glm::length(v.Normal);
+		glm::vec3 normal = length > 0.0f ? v.Normal / length : glm::vec3(0.0f);
+		p.Normal = glm::packSnorm3x10_1x2(glm::vec4(normal, 0.0f));
+		glm::vec3 decodedNormal = glm::vec3(glm::unpackSnorm3x10_1x2(p.Normal));
+		if (length > 0.0f) {
+			maxCosine = std::min(maxCosine, glm::dot(normal, glm::normalize(decodedNormal)));
+		}
+	}
+	float side = std::max(extent.x, std::max(extent.y, extent.z));
+	error.relativePosition = error.position / side;
+	error.normal = glm::degrees(std::acos(glm::clamp(maxCosine, -1.0f, 1.0f)));
+	return error;
+}
+
+#endif
@@ -0,0 +1,124 @@
+#ifndef RANGE_ALLOCATOR_H
+#define RANGE_ALLOCATOR_H
+
+#include <map>
+#include <cstddef>
+#include <cstdint>
+#include <iterator>
+
+/* Free list of a range [0, capacity) of units (vertices, indices...) : no memory of its own,
+* it only says where a block goes in a buffer allocated elsewhere (see GeometryPool).
+* allocate() takes the smallest free block large enough (best fit), release() merges the block with its free neighbours,
+* so the free list never holds two adjacent blocks.
+*/
+class RangeAllocator
+{
+public:
+	static const size_t invalid = SIZE_MAX;
+
+	explicit RangeAllocator(size_t capacity = 0) {
+		reset(capacity);
+	}
+
+	//everything free again
+	void reset(size_t capacity) {
+		total = capacity;
+		allocated = 0;
+		byOffset.clear();
+		bySize.clear();
+		if (capacity > 0) insertFree(0, capacity);
+	}
+
+	//more units at the end of the range, merged with the last free block
+	void grow(size_t capacity) {
+		if (capacity <= total) return;
+		size_t added = capacity - total;
+		size_t offset = total;
+		total = capacity;
+		//counted as allocated, then released : release() does the merge
+		allocated += added;
+		release(offset, added);
+	}
+
+	//offset of a block of size units, invalid if no free block is large enough
+	size_t allocate(size_t size) {
+		if (size == 0) return invalid;
+		auto best = bySize.lower_bound(size);
+		if (best == bySize.end()) return invalid;
+		size_t blockSize = best->first;
+		size_t offset = best->second;
+		eraseFree(offset, blockSize);
+		//the rest of the block stays free
+		if (blockSize > size) insertFree(offset + size, blockSize - size);
+		allocated += size;
+		return offset;
+	}
+
+	//give back a block : offset and size as returned by / given to allocate
+	void release(size_t offset, size_t size) {
+		if (size == 0) return;
+		allocated -= size;
+		auto next = byOffset.lower_bound(offset);
+		if (next != byOffset.end() && next->first == offset + size) {
+			size += next->second;
+			eraseFree(next->first, next->second);
+			next = byOffset.lower_bound(offset);
+		}
+		if (next != byOffset.begin()) {
+			auto previous = std::prev(next);
+			if (previous->first + previous->second == offset) {
+				offset = previous->first;
+				size += previous->second;
+				eraseFree(previous->first, previous->second);
+			}
+		}
+		insertFree(offset, size);
+	}
+
+	size_t capacity() const {
+		return total;
+	}
+
+	size_t used() const {
+		return allocated;
+	}
+
+	size_t freeBlocks() const {
+		return byOffset.size();
+	}
+
+	size_t largestFree() const {
+		return bySize.empty() ? 0 : bySize.rbegin()->first;
+	}
+
+	//0 : all the free space in one block, close to 1 : scattered in small blocks (a large request may fail with space left)
+	float fragmentation() const {
+		size_t free = total - allocated;
+		return free > 0 ? 1.0f - (float)largestFree() / free : 0.0f;
+	}
+
+private:
+	size_t total = 0;
+	size_t allocated = 0;
+	//the same free blocks, by position (to merge) and by size (to find the best fit)
+	std::map<size_t, size_t> byOffset;
+	std::multimap<size_t, size_t> bySize;
+
+	void insertFree(size_t offset, size_t size) {
+		byOffset.emplace(offset, size);
+		bySize.emplace(size, offset);
+	}
+
+	void eraseFree(size_t offset, size_t size) {
+		byOffset.erase(offset);
+		auto range = bySize.equal_range(size);
+		for (auto it = range.first; it != range.second; ++it) {
+			if (it->second == offset) {
+				bySize.erase(it);
+				return;
+			}
+		}
+	}
+};
+
+#endif
@@ -0,0 +1,100 @@
+#ifndef SCENE_GRAPH_H
+#define SCENE_GRAPH_H
+
+#include<iostream>
+#include <vector>
+
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+#include <glm/gtc/matrix_inverse.hpp>
+#include <glm/gtc/quaternion.hpp>
+
+/* Scene graph : nodes with a local transform (translation, rotation, scale) relative to their parent,
+* e.g. sun -> earth -> moon orbit -> moon.
+* The animation sets the local transforms from absolute values (an angle, not a rotation applied again every frame)
+* so nothing drifts. update() recomputes the world matrix and its inverse-transpose (the normal matrix)
+* only for the nodes whose transform changed and for their subtrees, the static nodes keep their cached matrices.
+* A parent is always created before its children : the nodes are stored in that order and updated in one pass.
+*/
+class SceneGraph
+{
+public:
+	typedef int NodeId;
+	static const NodeId root = -1;
+
+	NodeId addNode(NodeId parent = root, glm::vec3 position = glm::vec3(0.0), glm::quat rotation = glm::quat(1.0, 0.0, 0.0, 0.0), glm::vec3 scale = glm::vec3(1.0)) {
+		if (parent >= (NodeId)nodes.size()) {
+			std::cout << "Scene graph : unknown parent " << parent << ", the node is added at the root" << std::endl;
+			parent = root;
+		}
+		Node node;
+		node.parent = parent;
+		node.position = position;
+		node.rotation = rotation;
+		node.scale = scale;
+		nodes.push_back(node);
+		return nodes.size() - 1;
+	}
+
+	void setPosition(NodeId id, const glm::vec3& position) {
+		nodes[id].position = position;
+		nodes[id].dirty = true;
+	}
+
+	void setRotation(NodeId id, const glm::quat& rotation) {
+		nodes[id].rotation = rotation;
+		nodes[id].dirty = true;
+	}
+
+	void setScale(NodeId id, const glm::vec3& scale) {
+		nodes[id].scale = scale;
+		nodes[id].dirty = true;
+	}
+
+	//recompute the dirty subtrees, returns the number of nodes updated
+	int update() {
+		int updated = 0;
+		for (Node& node : nodes) {
+			//the parent is before the node : its flag is already final for this update
+			node.changed = node.dirty || (node.parent != root && nodes[node.parent].changed);
+			if (!node.changed) continue;
+
+			glm::mat4 local = glm::translate(glm::mat4(1.0), node.position) * glm::mat4_cast(node.rotation) * glm::scale(glm::mat4(1.0), node.scale);
+			node.world = node.parent == root ? local : nodes[node.parent].world * local;
+			node.itM = glm::inverseTranspose(node.world);
+			node.dirty = false;
+			updated++;
+		}
+		return updated;
+	}
+
+	//valid after update()
+	const glm::mat4& world(NodeId id) const {
+		return nodes[id].world;
+	}
+
+	const glm::mat4& inverseTranspose(NodeId id) const {
+		return nodes[id].itM;
+	}
+
+	size_t size() const {
+		return nodes.size();
+	}
+
+private:
+	struct Node {
+		NodeId parent;
+		glm::vec3 position;
+		glm::quat rotation;
+		glm::vec3 scale;
+		//local transform changed since the last update / world matrix recomputed by the last update
+		bool dirty = true;
+		bool changed = false;
+		glm::mat4 world = glm::mat4(1.0);
+		glm::mat4 itM = glm::mat4(1.0);
+	};
+
+	std::vector<Node> nodes;
+};
+
+#endif
@@ -3,10 +3,14 @@
 
 #include <glad/glad.h>
 
+#include "glState.h"
+#include "vertexLayout.h"
+
 #include <string>
 #include <fstream>
 #include <sstream>
 #include <iostream>
+#include <unordered_map>
 
 class Shader
 {
@@ -49,6 +53,7 @@ public:
         GLuint vertex = compileShader(vertexCode, GL_VERTEX_SHADER);
         GLuint fragment = compileShader(fragmentCode, GL_FRAGMENT_SHADER);
         ID = compileProgram(vertex, fragment);
+        reflectUniforms();
 	}
 
     Shader(std::string vShaderCode, std::string fShaderCode)
@@ -56,28 +61,87 @@ public:
         GLuint vertex = compileShader(vShaderCode, GL_VERTEX_SHADER);
         GLuint fragment = compileShader(fShaderCode, GL_FRAGMENT_SHADER);
         ID = compileProgram(vertex, fragment);
+        reflectUniforms();
     }
 
     void use() {
-        glUseProgram(ID);
+        glState().useProgram(ID);
+    }
+
+    // location of an active uniform, looked up in the table filled at link time (-1 if the uniform does not exist)
+    // resolve it once outside of the render loop and use the setters taking a location
+    GLint uniform(const GLchar* name) const {
+        auto found = uniforms.find(name);
+        return found != uniforms.end() ? found->second : -1;
+    }
+
+    // read the uniform block `name` from the buffer bound at `binding` (nothing if the program has no such block)
+    void bindUniformBlock(const GLchar* name, GLuint binding) {
+        GLuint index = glGetUniformBlockIndex(ID, name);
+        if (index != GL_INVALID_INDEX) {
+            glUniformBlockBinding(ID, index, binding);
+        }
     }
+
     void setInteger(const GLchar *name, GLint value) {
-        glUniform1i(glGetUniformLocation(ID, name), value);
+        setInteger(uniform(name), value);
     }
     void setFloat(const GLchar* name, GLfloat value) {
-        glUniform1f(glGetUniformLocation(ID, name), value);
+        setFloat(uniform(name), value);
     }
     void setVector3f(const GLchar* name, GLfloat x, GLfloat y, GLfloat z) {
-        glUniform3f(glGetUniformLocation(ID, name), x, y, z);
+        setVector3f(uniform(name), x, y, z);
     }
     void setVector3f(const GLchar* name, const glm::vec3& value) {
-        glUniform3f(glGetUniformLocation(ID, name), value.x, value.y, value.z);
+        setVector3f(uniform(name), value);
     }
     void setMatrix4(const GLchar* name, const glm::mat4& matrix) {
-        glUniformMatrix4fv(glGetUniformLocation(ID, name), 1, GL_FALSE, glm::value_ptr(matrix));
+        setMatrix4(uniform(name), matrix);
+    }
+
+    void setInteger(GLint location, GLint value) {
+        glUniform1i(location, value);
+    }
+    void setFloat(GLint location, GLfloat value) {
+        glUniform1f(location, value);
+    }
+    void setVector3f(GLint location, GLfloat x, GLfloat y, GLfloat z) {
+        glUniform3f(location, x, y, z);
+    }
+    void setVector3f(GLint location, const glm::vec3& value) {
+        glUniform3f(location, value.x, value.y, value.z);
+    }
+    void setMatrix4(GLint location, const glm::mat4& matrix) {
+        glUniformMatrix4fv(location, 1, GL_FALSE, glm::value_ptr(matrix));
     }
 
 private:
+    std::unordered_map<std::string, GLint> uniforms;
+
+    // fill the name -> location table with every active uniform of the linked program
+    void reflectUniforms()
+    {
+        GLint count = 0, maxLength = 0;
+        glGetProgramiv(ID, GL_ACTIVE_UNIFORMS, &count);
+        glGetProgramiv(ID, GL_ACTIVE_UNIFORM_MAX_LENGTH, &maxLength);
+        std::string name(maxLength > 0 ? maxLength : 1, '\0');
+        for (GLint i = 0; i < count; i++) {
+            GLsizei length = 0;
+            GLint size;
+            GLenum type;
+            glGetActiveUniform(ID, i, maxLength, &length, &size, &type, &name[0]);
+            std::string uniformName = name.substr(0, length);
+            GLint location = glGetUniformLocation(ID, uniformName.c_str());
+            // members of uniform blocks have no location
+            if (location < 0) continue;
+            uniforms[uniformName] = location;
+            // arrays are reported as "name[0]", also accept "name"
+            if (uniformName.size() > 3 && uniformName.compare(uniformName.size() - 3, 3, "[0]") == 0) {
+                uniforms[uniformName.substr(0, uniformName.size() - 3)] = location;
+            }
+        }
+    }
+
     GLuint compileShader(std::string shaderCode, GLenum shaderType)
     {
         GLuint shader = glCreateShader(shaderType);
@@ -109,6 +173,10 @@ private:
 
         glAttachShader(programID, vertexShader);
         glAttachShader(programID, fragmentShader);
+        // the vertex inputs get the locations of vertexLayout.h : the VAOs do not depend on the program
+        for (const AttributeName& input : attributeNames) {
+            glBindAttribLocation(programID, input.location, input.name);
+        }
         glLinkProgram(programID);
 
 
@@ -8,11 +8,14 @@
 #include <sstream>
 #include <iostream>
 
+#include "frameData.h"
+
 class ShaderInput
 {
 public:
     const std::string v_earth =
         "#version 330 core\n"
+        + frameDataGLSL +
         "in vec3 position; \n"
         "in vec2 tex_coord; \n"
         "in vec3 normal; \n"
@@ -24,8 +27,6 @@ public:
 
         "uniform mat4 M; \n"
         "uniform mat4 itM; \n"
-        "uniform mat4 V; \n"
-        "uniform mat4 P; \n"
 
         " void main(){ \n"
         "vec4 frag_coord = M*vec4(position, 1.0);"
@@ -36,7 +37,31 @@ public:
         "v_tex = tex_coord; \n"
         "}\n";
 
+    //same as v_earth, but M and itM come per instance from the instance buffer (see Object::makeInstances)
+    const std::string v_earth_instanced =
+        "#version 330 core\n"
+        + frameDataGLSL +
+        "in vec3 position; \n"
+        "in vec2 tex_coord; \n"
+        "in vec3 normal; \n"
+        "in mat4 instance_M; \n"
+        "in mat4 instance_itM; \n"
+
+        "out vec3 v_normal; \n"
+        "out vec3 v_frag_coord; \n"
+        "out vec2 v_tex; \n"
+
+        " void main(){ \n"
+        "vec4 frag_coord = instance_M*vec4(position, 1.0);"
+        "gl_Position = P*V*frag_coord;\n"
+        "v_normal = vec3(instance_itM * vec4(normal, 1.0)); \n"
+        "v_frag_coord = frag_coord.xyz; \n"
+        "\n"
+        "v_tex = tex_coord; \n"
+        "}\n";
+
     const std::string f_earth = "#version 330 core\n"
+        + frameDataGLSL +
         "out vec4 FragColor;"
         "precision mediump float; \n"
 
@@ -44,24 +69,10 @@ public:
         "in vec3 v_frag_coord; \n"
         "in vec2 v_tex; \n"
 
-        "uniform sampler2D texture; \n"
+        "uniform sampler2D textureSampler; \n"
         "uniform vec3 materialColour; \n"
 
-        "uniform vec3 u_view_pos; \n"
-
-        //for the light equation
-
-        "struct Light{\n"
-        "vec3 light_pos; \n"
-        "float ambient_strength; \n"
-        "float diffuse_strength; \n"
-        "float specular_strength; \n"
-        //attenuation factor
-        "float constant;\n"
-        "float linear;\n"
-        "float quadratic;\n"
-        "};\n"
-        "uniform Light light;"
+        //camera position and light come from the FrameData block
 
         "uniform float shininess; \n"
 
@@ -85,18 +96,17 @@ public:
         "float light = light.ambient_strength + attenuation * (diffuse + specular); \n"
 
         //applying light to object texture
-        "FragColor = texture(texture, v_tex) * vec4(light); \n"
+        "FragColor = texture(textureSampler, v_tex) * vec4(light); \n"
         "} \n";
 
     //for the cubemap
     const std::string sourceVCubeMap = "#version 330 core\n"
+        + frameDataGLSL +
         "in vec3 position; \n"
-        "in vec2 tex_coords; \n"
+        "in vec2 tex_coord; \n"
         "in vec3 normal; \n"
 
-        //only P and V are necessary
-        "uniform mat4 V; \n"
-        "uniform mat4 P; \n"
+        //only P and V (from FrameData) are necessary
 
         "out vec3 texCoord_v; \n"
 
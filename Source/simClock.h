@@ -0,0 +1,82 @@
+#ifndef SIM_CLOCK_H
+#define SIM_CLOCK_H
+
+#include <algorithm>
+
+/* Fixed timestep simulation clock :
+* advance() takes the time of the frame and returns how many steps of `step` seconds the simulation has to run
+* so that it keeps up with it, whatever the frame rate. The time left over (less than a step) gives alpha(),
+* where the frame is between the last two simulation states : the renderer interpolates between them.
+* The simulation can run slower than the rendering (step longer than a frame : 0 step on most frames).
+* After a long frame (loading, debugger) at most maxSteps steps are run, the simulation slows down instead of catching up.
+*/
+class SimClock
+{
+public:
+	//seconds per simulation step
+	const double step;
+
+	explicit SimClock(double step = 1.0 / 60.0, int maxSteps = 8) : step(step), maxSteps(maxSteps) {
+	}
+
+	//time of the first frame : the simulation starts there
+	void start(double now) {
+		last = now;
+		accumulator = 0.0;
+		steps = 0;
+		started = true;
+	}
+
+	//number of steps to run for the frame at now (seconds)
+	int advance(double now) {
+		if (!started) start(now);
+		elapsed = std::max(0.0, now - last);
+		last = now;
+		accumulator += elapsed;
+
+		//the tolerance keeps frame times that are exact multiples of the step (headless) from losing a step to rounding
+		int count = (int)(accumulator / step + 1e-6);
+		if (count > maxSteps) {
+			count = maxSteps;
+			accumulator = 0.0;
+		}
+		else {
+			accumulator = std::max(0.0, accumulator - count * step);
+		}
+		steps += count;
+		return count;
+	}
+
+	//0 : the frame shows the previous state, 1 : the last one
+	double alpha() const {
+		return std::min(1.0, accumulator / step);
+	}
+
+	//simulation time at the last step, and at the frame (between the last two steps)
+	double time() const {
+		return steps * step;
+	}
+
+	double renderTime() const {
+		return std::max(0.0, time() - step + alpha() * step);
+	}
+
+	//real seconds since the previous frame
+	double frameDuration() const {
+		return elapsed;
+	}
+
+	long long stepCount() const {
+		return steps;
+	}
+
+private:
+	int maxSteps;
+	double last = 0.0;
+	double accumulator = 0.0;
+	double elapsed = 0.0;
+	long long steps = 0;
+	bool started = false;
+};
+
+#endif
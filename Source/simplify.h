@@ -0,0 +1,407 @@
+#ifndef SIMPLIFY_H
+#define SIMPLIFY_H
+
+#include <vector>
+#include <queue>
+#include <unordered_map>
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <cmath>
+
+#include <glm/glm.hpp>
+
+/* Mesh simplification with quadric error metrics (Garland & Heckbert) :
+* every position accumulates the planes of its triangles (weighted by their area) in a quadric, collapsing an edge
+* u -> v costs the distance of v to the planes of both ends. The cheapest edges are collapsed first.
+* The collapses keep the existing positions (u moves onto v), and a corner that moved takes a vertex of the mesh
+* already at its new position : the levels of detail only add indices, never vertices.
+*
+* The positions are welded first : OBJ files split a position into several vertices on texture seams and hard
+* edges. The texture coordinate of a corner follows the collapse, and a texture seam only collapses along itself.
+* Among the vertices with that texture coordinate, a moved corner takes the one whose normal is the closest to its own :
+* on a faceted mesh (the bunny) the coarse levels are shaded with the normals of neighbouring faces.
+* Open borders get extra planes so they keep their shape.
+* A collapse is refused when it would flip a triangle or pinch the surface (link condition).
+*/
+
+//one level of detail : a range of the index buffer, and the error of the simplification (model units)
+struct MeshLod {
+	uint32_t firstIndex;
+	uint32_t indexCount;
+	float error;
+};
+//stored as is in the mesh cache
+static_assert(sizeof(MeshLod) == 12, "MeshLod must be tightly packed");
+
+
+/* The simplifier works on a copy of the mesh and can be called with smaller and smaller targets : each level
+* continues from the previous one, the chain is nested. V has Position, Texture and Normal members (Vertex of mesh.h).
+*/
+template<typename V>
+class MeshSimplifier
+{
+public:
+	MeshSimplifier(const V* vertices, size_t vertexCount, const uint32_t* indices, size_t indexCount)
+		: source(vertices, vertices + vertexCount) {
+		weld();
+		size_t triangles = indexCount / 3;
+		cornerPosition.resize(3 * triangles);
+		cornerTexture.resize(3 * triangles);
+		cornerNormal.resize(3 * triangles);
+		alive.assign(triangles, 1);
+		for (size_t c = 0; c < 3 * triangles; c++) {
+			cornerPosition[c] = welded[indices[c]];
+			cornerTexture[c] = cornerNormal[c] = indices[c];
+		}
+		liveTriangles = triangles;
+		for (size_t t = 0; t < triangles; t++) {
+			uint32_t a = cornerPosition[3 * t], b = cornerPosition[3 * t + 1], d = cornerPosition[3 * t + 2];
+			if (a == b || b == d || a == d) {
+				alive[t] = 0;
+				liveTriangles--;
+				continue;
+			}
+			for (int k = 0; k < 3; k++) adjacency[cornerPosition[3 * t + k]].push_back(t);
+		}
+		computeQuadrics();
+		for (uint32_t p = 0; p < positions.size(); p++) pushEdges(p);
+	}
+
+	size_t triangleCount() const {
+		return liveTriangles;
+	}
+
+	//collapse edges until at most target triangles are left (or no collapse is allowed), returns the error so far
+	float simplify(size_t target) {
+		while (liveTriangles > target && !heap.empty()) {
+			Collapse collapse = heap.top();
+			heap.pop();
+			if (!positionAlive[collapse.from] || !positionAlive[collapse.to]
+				|| stamp[collapse.from] != collapse.stampFrom || stamp[collapse.to] != collapse.stampTo) continue;
+			if (!apply(collapse.from, collapse.to)) continue;
+			maxError = std::max(maxError, collapse.cost);
+		}
+		return std::sqrt(maxError);
+	}
+
+	/* Append the current triangles, indexing the vertices of the mesh : a corner that did not move keeps its vertex,
+	* the others take the vertex at their position with their texture coordinate and the closest normal.
+	*/
+	void emit(std::vector<uint32_t>& indices) const {
+		for (size_t t = 0; t < alive.size(); t++) {
+			if (!alive[t]) continue;
+			for (int k = 0; k < 3; k++) {
+				size_t c = 3 * t + k;
+				const V& original = source[cornerNormal[c]];
+				const glm::vec2& texture = source[cornerTexture[c]].Texture;
+				//cornerTexture is always at the position of the corner : there is at least one candidate
+				uint32_t best = cornerTexture[c];
+				float bestDot = glm::dot(source[best].Normal, original.Normal);
+				for (uint32_t a = vertexStart[cornerPosition[c]]; a < vertexStart[cornerPosition[c] + 1]; a++) {
+					uint32_t v = positionVertices[a];
+					if (source[v].Texture != texture) continue;
+					float dot = glm::dot(source[v].Normal, original.Normal);
+					//the original vertex first when it is still there
+					if (v == cornerNormal[c] || dot > bestDot) {
+						best = v;
+						bestDot = v == cornerNormal[c] ? 2.0f : dot;
+					}
+				}
+				indices.push_back(best);
+			}
+		}
+	}
+
+private:
+	//symmetric 4x4 matrix : xx xy xz xw yy yz yw zz zw ww, and the total weight of its planes
+	struct Quadric {
+		double a[10] = { 0.0 };
+		double weight = 0.0;
+
+		void addPlane(const glm::dvec3& n, double d, double w) {
+			double q[10] = { n.x * n.x, n.x * n.y, n.x * n.z, n.x * d, n.y * n.y, n.y * n.z, n.y * d, n.z * n.z, n.z * d, d * d };
+			for (int i = 0; i < 10; i++) a[i] += w * q[i];
+			weight += w;
+		}
+
+		void add(const Quadric& other) {
+			for (int i = 0; i < 10; i++) a[i] += other.a[i];
+			weight += other.weight;
+		}
+
+		//weighted mean of the squared distances of p to the planes
+		double error(const glm::dvec3& p) const {
+			double e = a[0] * p.x * p.x + 2.0 * a[1] * p.x * p.y + 2.0 * a[2] * p.x * p.z + 2.0 * a[3] * p.x
+				+ a[4] * p.y * p.y + 2.0 * a[5] * p.y * p.z + 2.0 * a[6] * p.y
+				+ a[7] * p.z * p.z + 2.0 * a[8] * p.z + a[9];
+			return weight > 0.0 ? std::max(0.0, e) / weight : 0.0;
+		}
+	};
+
+	struct Collapse {
+		float cost;
+		uint32_t from, to;
+		uint32_t stampFrom, stampTo;
+
+		bool operator>(const Collapse& other) const {
+			return cost > other.cost;
+		}
+	};
+
+	//the open borders weigh more than the faces : they are the silhouette of the mesh
+	static constexpr double borderWeight = 10.0;
+	//largest change of direction of a triangle normal allowed by a collapse (cosine)
+	static constexpr double minNormalDot = 0.25;
+
+	std::vector<V> source;
+	//original vertex -> welded position, and the vertices of each position (positionVertices[vertexStart[p]...])
+	std::vector<uint32_t> welded;
+	std::vector<uint32_t> vertexStart, positionVertices;
+	std::vector<glm::vec3> positions;
+	std::vector<Quadric> quadrics;
+	std::vector<uint8_t> positionAlive;
+	//incremented at each change of the position : older collapses of the heap are ignored
+	std::vector<uint32_t> stamp;
+	//triangles around each position (may still list removed triangles)
+	std::vector<std::vector<uint32_t>> adjacency;
+
+	//per corner : welded position, vertex giving the texture coordinate, vertex giving the normal
+	std::vector<uint32_t> cornerPosition, cornerTexture, cornerNormal;
+	std::vector<uint8_t> alive;
+	size_t liveTriangles = 0;
+
+	std::priority_queue<Collapse, std::vector<Collapse>, std::greater<Collapse>> heap;
+	float maxError = 0.0f;
+
+	struct PositionHash {
+		size_t operator()(const glm::vec3& p) const {
+			uint32_t bits[3];
+			memcpy(bits, &p[0], sizeof(bits));
+			return ((size_t)bits[0] * 73856093u) ^ ((size_t)bits[1] * 19349663u) ^ ((size_t)bits[2] * 83492791u);
+		}
+	};
+
+	void weld() {
+		std::unordered_map<glm::vec3, uint32_t, PositionHash> ids;
+		ids.reserve(source.size());
+		welded.resize(source.size());
+		for (size_t i = 0; i < source.size(); i++) {
+			auto inserted = ids.emplace(source[i].Position, (uint32_t)positions.size());
+			if (inserted.second) positions.push_back(source[i].Position);
+			welded[i] = inserted.first->second;
+		}
+		vertexStart.assign(positions.size() + 1, 0);
+		for (uint32_t p : welded) vertexStart[p + 1]++;
+		for (size_t p = 0; p < positions.size(); p++) vertexStart[p + 1] += vertexStart[p];
+		positionVertices.resize(source.size());
+		std::vector<uint32_t> filled(vertexStart.begin(), vertexStart.end() - 1);
+		for (size_t i = 0; i < source.size(); i++) positionVertices[filled[welded[i]]++] = i;
+
+		quadrics.resize(positions.size());
+		positionAlive.assign(positions.size(), 1);
+		stamp.assign(positions.size(), 0);
+		adjacency.resize(positions.size());
+	}
+
+	glm::dvec3 faceNormal(uint32_t a, uint32_t b, uint32_t c) const {
+		glm::dvec3 p0 = positions[a], p1 = positions[b], p2 = positions[c];
+		return glm::cross(p1 - p0, p2 - p0);
+	}
+
+	void computeQuadrics() {
+		//edges of a single triangle are borders
+		std::unordered_map<uint64_t, int> edgeCount;
+		for (size_t t = 0; t < alive.size(); t++) {
+			if (!alive[t]) continue;
+			for (int k = 0; k < 3; k++) {
+				uint32_t a = cornerPosition[3 * t + k], b = cornerPosition[3 * t + (k + 1) % 3];
+				edgeCount[(uint64_t)std::min(a, b) << 32 | std::max(a, b)]++;
+			}
+		}
+
+		for (size_t t = 0; t < alive.size(); t++) {
+			if (!alive[t]) continue;
+			const uint32_t* p = &cornerPosition[3 * t];
+			glm::dvec3 n = faceNormal(p[0], p[1], p[2]);
+			double length = glm::length(n);
+			if (length == 0.0) continue;
+			n /= length;
+			double d = -glm::dot(n, glm::dvec3(positions[p[0]]));
+			for (int k = 0; k < 3; k++) quadrics[p[k]].addPlane(n, d, 0.5 * length);
+
+			for (int k = 0; k < 3; k++) {
+				uint32_t a = p[k], b = p[(k + 1) % 3];
+				if (edgeCount[(uint64_t)std::min(a, b) << 32 | std::max(a, b)] != 1) continue;
+				//plane through the border edge, perpendicular to the triangle
+				glm::dvec3 edge = glm::dvec3(positions[b]) - glm::dvec3(positions[a]);
+				glm::dvec3 side = glm::cross(edge, n);
+				double sideLength = glm::length(side);
+				if (sideLength == 0.0) continue;
+				side /= sideLength;
+				double sideD = -glm::dot(side, glm::dvec3(positions[a]));
+				double w = borderWeight * glm::dot(edge, edge);
+				quadrics[a].addPlane(side, sideD, w);
+				quadrics[b].addPlane(side, sideD, w);
+			}
+		}
+	}
+
+	float cost(uint32_t from, uint32_t to) const {
+		Quadric q = quadrics[from];
+		q.add(quadrics[to]);
+		return (float)q.error(glm::dvec3(positions[to]));
+	}
+
+	//both directions of every edge around p
+	void pushEdges(uint32_t p) {
+		for (uint32_t t : adjacency[p]) {
+			if (!alive[t]) continue;
+			for (int k = 0; k < 3; k++) {
+				uint32_t q = cornerPosition[3 * t + k];
+				if (q == p) continue;
+				heap.push(Collapse{ cost(p, q), p, q, stamp[p], stamp[q] });
+				heap.push(Collapse{ cost(q, p), q, p, stamp[q], stamp[p] });
+			}
+		}
+	}
+
+	void neighbours(uint32_t p, std::vector<uint32_t>& result) const {
+		result.clear();
+		for (uint32_t t : adjacency[p]) {
+			if (!alive[t]) continue;
+			for (int k = 0; k < 3; k++) {
+				if (cornerPosition[3 * t + k] != p) result.push_back(cornerPosition[3 * t + k]);
+			}
+		}
+		std::sort(result.begin(), result.end());
+		result.erase(std::unique(result.begin(), result.end()), result.end());
+	}
+
+	//collapse from onto to if it is allowed
+	bool apply(uint32_t from, uint32_t to) {
+		//triangles of the edge, removed by the collapse
+		removed.clear();
+		for (uint32_t t : adjacency[from]) {
+			if (!alive[t]) continue;
+			for (int k = 0; k < 3; k++) {
+				if (cornerPosition[3 * t + k] == to) removed.push_back(t);
+			}
+		}
+		if (removed.empty() || removed.size() > 2) return false;
+
+		//link condition : the ends only share the third corners of the removed triangles
+		neighbours(from, fromNeighbours);
+		neighbours(to, toNeighbours);
+		size_t shared = 0;
+		for (size_t i = 0, j = 0; i < fromNeighbours.size() && j < toNeighbours.size();) {
+			if (fromNeighbours[i] < toNeighbours[j]) i++;
+			else if (fromNeighbours[i] > toNeighbours[j]) j++;
+			else {
+				shared++;
+				i++;
+				j++;
+			}
+		}
+		if (shared != removed.size()) return false;
+
+		//texture coordinates of from in the removed triangles -> vertex of to in the same triangle
+		textureMap.clear();
+		for (uint32_t t : removed) {
+			uint32_t fromVertex = 0, toVertex = 0;
+			for (int k = 0; k < 3; k++) {
+				if (cornerPosition[3 * t + k] == from) fromVertex = cornerTexture[3 * t + k];
+				if (cornerPosition[3 * t + k] == to) toVertex = cornerTexture[3 * t + k];
+			}
+			textureMap.push_back(std::make_pair(source[fromVertex].Texture, toVertex));
+		}
+
+		for (uint32_t t : adjacency[from]) {
+			if (!alive[t] || std::find(removed.begin(), removed.end(), t) != removed.end()) continue;
+			uint32_t* p = &cornerPosition[3 * t];
+			//a texture coordinate of from which is not on the edge : the edge crosses a seam
+			for (int k = 0; k < 3; k++) {
+				if (p[k] == from && mappedTexture(cornerTexture[3 * t + k]) < 0) return false;
+			}
+			//no flipped or degenerate triangle
+			glm::dvec3 before = faceNormal(p[0], p[1], p[2]);
+			glm::dvec3 after = faceNormal(p[0] == from ? to : p[0], p[1] == from ? to : p[1], p[2] == from ? to : p[2]);
+			double lengths = glm::length(before) * glm::length(after);
+			if (lengths == 0.0 || glm::dot(before, after) < minNormalDot * lengths) return false;
+		}
+
+		for (uint32_t t : removed) {
+			alive[t] = 0;
+			liveTriangles--;
+		}
+		for (uint32_t t : adjacency[from]) {
+			if (!alive[t]) continue;
+			for (int k = 0; k < 3; k++) {
+				size_t c = 3 * t + k;
+				if (cornerPosition[c] != from) continue;
+				cornerPosition[c] = to;
+				cornerTexture[c] = mappedTexture(cornerTexture[c]);
+			}
+			adjacency[to].push_back(t);
+		}
+		std::vector<uint32_t>().swap(adjacency[from]);
+		adjacency[to].erase(std::remove_if(adjacency[to].begin(), adjacency[to].end(), [this](uint32_t t) { return !alive[t]; }), adjacency[to].end());
+
+		quadrics[to].add(quadrics[from]);
+		positionAlive[from] = 0;
+		stamp[to]++;
+		pushEdges(to);
+		return true;
+	}
+
+	//vertex of to with the texture coordinate of vertex, -1 if there is none
+	int64_t mappedTexture(uint32_t vertex) const {
+		for (const auto& entry : textureMap) {
+			if (entry.first == source[vertex].Texture) return entry.second;
+		}
+		return -1;
+	}
+
+	//scratch of apply
+	std::vector<uint32_t> removed, fromNeighbours, toNeighbours;
+	std::vector<std::pair<glm::vec2, uint32_t>> textureMap;
+};
+
+
+/* Levels of detail of an indexed mesh : level 0 is the mesh itself, each next level has half the triangles
+* of the previous one. The levels are appended to indices (one buffer for all of them) and use the same vertices.
+* The chain stops when the mesh is small or cannot be simplified any further.
+*/
+template<typename V>
+std::vector<MeshLod> buildLods(const std::vector<V>& vertices, std::vector<uint32_t>& indices, int maxLevels = 5, size_t minTriangles = 64) {
+	std::vector<MeshLod> lods;
+	lods.push_back(MeshLod{ 0, (uint32_t)indices.size(), 0.0f });
+	if (indices.size() / 3 < 2 * minTriangles) return lods;
+
+	MeshSimplifier<V> simplifier(vertices.data(), vertices.size(), indices.data(), indices.size());
+	for (int level = 1; level < maxLevels; level++) {
+		size_t previous = lods.back().indexCount / 3;
+		float error = simplifier.simplify(previous / 2);
+		//less than 10% fewer triangles : not worth a level
+		if (simplifier.triangleCount() > previous * 9 / 10) break;
+		MeshLod lod = { (uint32_t)indices.size(), 0, error };
+		simplifier.emit(indices);
+		lod.indexCount = indices.size() - lod.firstIndex;
+		lods.push_back(lod);
+		if (simplifier.triangleCount() < 2 * minTriangles) break;
+	}
+	return lods;
+}
+
+/* Level to draw for an object whose model units measure pixelsPerUnit pixels on screen : the coarsest level whose
+* error stays under threshold pixels. Hysteresis : a coarser level is only taken with some margin under the threshold,
+* so an object at the limit does not switch back and forth every frame.
+*/
+inline int chooseLod(const std::vector<MeshLod>& lods, int current, float pixelsPerUnit, float threshold = 1.0f, float hysteresis = 0.25f) {
+	current = std::max(0, std::min(current, (int)lods.size() - 1));
+	while (current > 0 && lods[current].error * pixelsPerUnit > threshold) current--;
+	while (current + 1 < (int)lods.size() && lods[current + 1].error * pixelsPerUnit < threshold * (1.0f - hysteresis)) current++;
+	return current;
+}
+
+#endif
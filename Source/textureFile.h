@@ -0,0 +1,307 @@
+#ifndef TEXTURE_FILE_H
+#define TEXTURE_FILE_H
+
+#include <iostream>
+#include <string>
+#include <vector>
+#include <cstdio>
+#include <cstdint>
+#include <cstring>
+#include <algorithm>
+#include <thread>
+#include <atomic>
+#include <functional>
+
+#include <glad/glad.h>
+
+#include "stb_image.h"
+#include "stb_dxt.h"
+#include "stb_image_resize.h"
+
+#include "meshCache.h"
+
+/* Baked textures (--bake-textures) :
+* the source images are decoded once offline, their mipmaps are built (gamma correct) and every level is compressed to BC1 (RGB)
+* or BC3 (RGBA) with stb_dxt. At runtime the file is mapped and the blocks go straight to glCompressedTexImage2D,
+* with no image decoding and 4 (BC3) to 6 (BC1 vs RGB) times less memory to upload.
+* Like the mesh cache, the file stores the size, time and hash of each source to detect when it is stale.
+*
+* layout : TextureFileHeader | faces * TextureFileSource | faces * levels TextureFileLevel (face after face) | compressed blocks
+*/
+
+const char textureFileMagic[4] = { 'T', 'E', 'X', 'B' };
+const uint32_t textureFileVersion = 2;
+
+struct TextureFileHeader {
+	char magic[4];
+	uint32_t version;
+	//content
+	uint32_t format;
+	uint32_t width;
+	uint32_t height;
+	//1 : 2D texture, 6 : cubemap faces in the order of the GL targets (+X, -X, +Y, -Y, +Z, -Z)
+	uint32_t faces;
+	uint32_t levels;
+	uint32_t padding;
+};
+
+//source image of a face
+struct TextureFileSource {
+	uint64_t size;
+	int64_t time;
+	uint64_t hash;
+};
+
+struct TextureFileLevel {
+	uint32_t width;
+	uint32_t height;
+	uint64_t offset;
+	uint64_t size;
+};
+
+inline std::string textureFilePath(const std::string& sourcePath) {
+	return sourcePath + ".texb";
+}
+
+//bytes per 4x4 block of a BC format
+inline int blockBytes(GLenum format) {
+	return format == GL_COMPRESSED_RGB_S3TC_DXT1_EXT ? 8 : 16;
+}
+
+//bytes of a width x height level of a BC format : whole 4x4 blocks
+inline uint64_t levelBytes(GLenum format, uint32_t width, uint32_t height) {
+	return (uint64_t)((width + 3) / 4) * ((height + 3) / 4) * blockBytes(format);
+}
+
+//levels of a full mipmap chain, down to 1x1
+inline uint32_t mipmapLevels(uint32_t width, uint32_t height) {
+	uint32_t levels = 1;
+	for (uint32_t size = std::max(width, height); size > 1; size /= 2) levels++;
+	return levels;
+}
+
+//a source is unchanged if it has the same size, and the same time or else the same content (copy, checkout...)
+inline bool sameSource(const std::string& path, const TextureFileSource& source) {
+	uint64_t size, hash;
+	int64_t time;
+	return statFile(path.c_str(), size, time) && size == source.size
+		&& (time == source.time || (hashFile(path.c_str(), hash) && hash == source.hash));
+}
+
+
+//read side : maps a baked texture and checks it against its sources
+class TextureFile
+{
+public:
+	const TextureFileHeader* header = nullptr;
+
+	/* returns false if the file is missing, corrupted or if one of its sources changed (or cannot be read).
+	* Every level must have the size of its mipmap and hold exactly its blocks : the streamer copies them without checking.
+	*/
+	bool open(const char* path, const std::vector<std::string>& sources) {
+		header = nullptr;
+		if (!file.open(path) || file.size() < sizeof(TextureFileHeader)) {
+			return false;
+		}
+		const TextureFileHeader* h = (const TextureFileHeader*)file.data();
+		bool valid = memcmp(h->magic, textureFileMagic, 4) == 0 && h->version == textureFileVersion
+			&& (h->format == GL_COMPRESSED_RGB_S3TC_DXT1_EXT || h->format == GL_COMPRESSED_RGBA_S3TC_DXT5_EXT)
+			&& h->width > 0 && h->height > 0 && h->faces == sources.size() && h->levels > 0 && h->levels <= mipmapLevels(h->width, h->height)
+			&& file.size() >= sizeof(TextureFileHeader) + (uint64_t)h->faces * (sizeof(TextureFileSource) + h->levels * sizeof(TextureFileLevel));
+
+		const TextureFileSource* stored = (const TextureFileSource*)(h + 1);
+		const TextureFileLevel* levels = (const TextureFileLevel*)(stored + (valid ? h->faces : 0));
+		for (uint32_t i = 0; valid && i < h->faces * h->levels; i++) {
+			const TextureFileLevel& l = levels[i];
+			uint32_t level = i % h->levels;
+			valid = l.width == std::max(1u, h->width >> level) && l.height == std::max(1u, h->height >> level)
+				&& l.size == levelBytes(h->format, l.width, l.height)
+				&& l.offset <= file.size() && l.size <= file.size() - l.offset;
+		}
+		//face by face : swapped faces are stale too
+		for (uint32_t face = 0; valid && face < h->faces; face++) {
+			valid = sameSource(sources[face], stored[face]);
+		}
+		if (!valid) {
+			file.close();
+			return false;
+		}
+		header = h;
+		return true;
+	}
+
+	const TextureFileLevel& level(uint32_t face, uint32_t level) const {
+		const TextureFileLevel* levels = (const TextureFileLevel*)((const TextureFileSource*)(header + 1) + header->faces);
+		return levels[face * header->levels + level];
+	}
+
+	const unsigned char* data(uint32_t face, uint32_t level) const {
+		return (const unsigned char*)file.data() + this->level(face, level).offset;
+	}
+
+	void close() {
+		file.close();
+		header = nullptr;
+	}
+
+private:
+	MappedFile file;
+};
+
+
+//write side
+
+//compress an RGBA image, 4x4 blocks, the blocks on the right and bottom edges repeat the last column / row
+inline std::vector<unsigned char> compressBC(const unsigned char* rgba, int width, int height, bool alpha) {
+	int blocksX = (width + 3) / 4;
+	int blocksY = (height + 3) / 4;
+	int bytes = alpha ? 16 : 8;
+	std::vector<unsigned char> blocks((size_t)blocksX * blocksY * bytes);
+
+	unsigned char block[16 * 4];
+	for (int by = 0; by < blocksY; by++) {
+		for (int bx = 0; bx < blocksX; bx++) {
+			for (int y = 0; y < 4; y++) {
+				int sy = std::min(by * 4 + y, height - 1);
+				for (int x = 0; x < 4; x++) {
+					int sx = std::min(bx * 4 + x, width - 1);
+					memcpy(block + (y * 4 + x) * 4, rgba + ((size_t)sy * width + sx) * 4, 4);
+				}
+			}
+			stb_compress_dxt_block(&blocks[((size_t)by * blocksX + bx) * bytes], block, alpha ? 1 : 0, STB_DXT_HIGHQUAL);
+		}
+	}
+	return blocks;
+}
+
+//run task(0) ... task(count - 1) on all the cores
+inline void parallelFor(int count, const std::function<void(int)>& task) {
+	int threads = std::min<int>(count, std::max(1u, std::thread::hardware_concurrency()));
+	std::atomic<int> next(0);
+	auto work = [&]() {
+		for (int i = next++; i < count; i = next++) task(i);
+	};
+	std::vector<std::thread> pool;
+	for (int i = 1; i < threads; i++) pool.emplace_back(work);
+	work();
+	for (std::thread& thread : pool) thread.join();
+}
+
+/* Next mipmap level, half the size of the previous one :
+* stb_image_resize filters in linear space (the images are sRGB encoded) so the small levels do not get darker.
+* The edges follow the wrap mode of the texture : reflected for the 2D textures (GL_MIRRORED_REPEAT), clamped for the cubemap faces.
+*/
+inline std::vector<unsigned char> nextLevel(const std::vector<unsigned char>& rgba, int width, int height, bool alpha, stbir_edge edge) {
+	int levelWidth = std::max(1, width / 2);
+	int levelHeight = std::max(1, height / 2);
+	std::vector<unsigned char> out((size_t)levelWidth * levelHeight * 4);
+	stbir_resize_uint8_srgb_edgemode(rgba.data(), width, height, 0, out.data(), levelWidth, levelHeight, 0, 4,
+		alpha ? 3 : STBIR_ALPHA_CHANNEL_NONE, 0, edge);
+	return out;
+}
+
+/* Bake one texture (one source) or a cubemap (six sources, in the order of the GL targets).
+* flip : same as at load time, 2D textures are stored bottom row first.
+* The faces are decoded and filtered in parallel, then every level of every face is compressed on its own, in parallel.
+*/
+inline bool bakeTexture(const std::vector<std::string>& sources, const char* path, bool flip) {
+	TextureFileHeader header;
+	memset(&header, 0, sizeof(header));
+	memcpy(header.magic, textureFileMagic, 4);
+	header.version = textureFileVersion;
+	header.faces = sources.size();
+	std::vector<TextureFileSource> stored(sources.size());
+	for (size_t face = 0; face < sources.size(); face++) {
+		TextureFileSource& source = stored[face];
+		if (!statFile(sources[face].c_str(), source.size, source.time) || !hashFile(sources[face].c_str(), source.hash)) {
+			std::cout << "Could not read the sources of " << path << std::endl;
+			return false;
+		}
+	}
+
+	//BC3 only if one of the images has an alpha channel
+	bool alpha = false;
+	for (const std::string& source : sources) {
+		int w, h, channels;
+		if (stbi_info(source.c_str(), &w, &h, &channels) && (channels == 2 || channels == 4)) alpha = true;
+	}
+	header.format = alpha ? GL_COMPRESSED_RGBA_S3TC_DXT5_EXT : GL_COMPRESSED_RGB_S3TC_DXT1_EXT;
+
+	//decode the faces and build their mipmaps : chains[face][level] (RGBA)
+	stbir_edge edge = sources.size() == 6 ? STBIR_EDGE_CLAMP : STBIR_EDGE_REFLECT;
+	std::vector<std::vector<std::vector<unsigned char>>> chains(sources.size());
+	std::vector<int> widths(sources.size()), heights(sources.size());
+	parallelFor(sources.size(), [&](int face) {
+		int channels;
+		stbi_set_flip_vertically_on_load_thread(flip);
+		unsigned char* pixels = stbi_load(sources[face].c_str(), &widths[face], &heights[face], &channels, 4);
+		if (!pixels) {
+			std::cout << "Failed to Load texture " << sources[face] << std::endl;
+			return;
+		}
+		std::vector<std::vector<unsigned char>>& chain = chains[face];
+		chain.emplace_back(pixels, pixels + (size_t)widths[face] * heights[face] * 4);
+		stbi_image_free(pixels);
+
+		for (int width = widths[face], height = heights[face]; width > 1 || height > 1; width = std::max(1, width / 2), height = std::max(1, height / 2)) {
+			chain.push_back(nextLevel(chain.back(), width, height, alpha, edge));
+		}
+	});
+	for (size_t face = 0; face < sources.size(); face++) {
+		if (chains[face].empty()) return false;
+		if (widths[face] != widths[0] || heights[face] != heights[0]) {
+			std::cout << "The faces of " << path << " do not have the same size" << std::endl;
+			return false;
+		}
+	}
+	header.width = widths[0];
+	header.height = heights[0];
+	header.levels = chains[0].size();
+
+	//compress every level
+	std::vector<TextureFileLevel> levels(header.faces * header.levels);
+	std::vector<std::vector<unsigned char>> blocks(levels.size());
+	parallelFor(levels.size(), [&](int index) {
+		int face = index / header.levels;
+		int level = index % header.levels;
+		int width = std::max(1u, header.width >> level);
+		int height = std::max(1u, header.height >> level);
+		blocks[index] = compressBC(chains[face][level].data(), width, height, alpha);
+		std::vector<unsigned char>().swap(chains[face][level]);
+		levels[index] = TextureFileLevel{ (uint32_t)width, (uint32_t)height, 0, blocks[index].size() };
+	});
+
+	uint64_t offset = sizeof(TextureFileHeader) + stored.size() * sizeof(TextureFileSource) + levels.size() * sizeof(TextureFileLevel);
+	for (TextureFileLevel& level : levels) {
+		level.offset = offset;
+		offset += level.size;
+	}
+
+	//write next to the final file then rename, as the mesh cache
+	std::string tmpPath = std::string(path) + ".tmp";
+	FILE* out = fopen(tmpPath.c_str(), "wb");
+	if (!out) {
+		std::cout << "Could not write " << path << std::endl;
+		return false;
+	}
+	bool ok = fwrite(&header, sizeof(header), 1, out) == 1;
+	ok = ok && fwrite(stored.data(), sizeof(TextureFileSource), stored.size(), out) == stored.size();
+	ok = ok && fwrite(levels.data(), sizeof(TextureFileLevel), levels.size(), out) == levels.size();
+	for (const std::vector<unsigned char>& level : blocks) {
+		ok = ok && fwrite(level.data(), 1, level.size(), out) == level.size();
+	}
+	ok = fclose(out) == 0 && ok;
+
+	std::remove(path);
+	if (!ok || std::rename(tmpPath.c_str(), path) != 0) {
+		std::remove(tmpPath.c_str());
+		std::cout << "Could not write " << path << std::endl;
+		return false;
+	}
+
+	std::cout << "Baked " << path << " : " << header.faces << " x " << header.width << "x" << header.height << ", " << header.levels
+		<< " levels, " << (alpha ? "BC3" : "BC1") << ", " << offset / 1024 << " KB" << std::endl;
+	return true;
+}
+
+#endif
@@ -0,0 +1,178 @@
+#ifndef TEXTURE_LOADER_H
+#define TEXTURE_LOADER_H
+
+#include<iostream>
+#include <string>
+#include <vector>
+#include <deque>
+#include <memory>
+#include <functional>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <utility>
+
+#include "stb_image.h"
+
+/* Image decoding off the GL thread :
+* load() queues the files of a texture, worker threads decode them with stb_image,
+* and poll() (on the GL thread, once per frame) hands each texture whose files are all decoded to its callback for the upload.
+* With 0 threads the files are decoded in load() and the callback is called at once (the former synchronous loading).
+*/
+
+struct Image {
+	std::string path;
+	int width = 0, height = 0, channels = 0;
+	unsigned char* pixels = nullptr;
+
+	Image() = default;
+	Image(const Image&) = delete;
+	Image& operator=(const Image&) = delete;
+	Image(Image&& other) : path(std::move(other.path)), width(other.width), height(other.height), channels(other.channels), pixels(other.pixels) {
+		other.pixels = nullptr;
+	}
+	Image& operator=(Image&& other) {
+		std::swap(path, other.path);
+		std::swap(width, other.width);
+		std::swap(height, other.height);
+		std::swap(channels, other.channels);
+		std::swap(pixels, other.pixels);
+		return *this;
+	}
+	~Image() {
+		stbi_image_free(pixels);
+	}
+
+	//decoded with its own channel count, flipped for the 2D textures (OpenGL starts at the bottom row)
+	static Image decode(const std::string& path, bool flip) {
+		Image image;
+		image.path = path;
+		stbi_set_flip_vertically_on_load_thread(flip);
+		image.pixels = stbi_load(path.c_str(), &image.width, &image.height, &image.channels, 0);
+		if (!image.pixels) {
+			std::cout << "Failed to Load texture " << path << std::endl;
+			std::cout << stbi_failure_reason() << std::endl;
+		}
+		return image;
+	}
+};
+
+class TextureLoader
+{
+public:
+	//called on the GL thread with the images in the order of the paths (pixels == nullptr if the file could not be read)
+	typedef std::function<void(std::vector<Image>& images)> Callback;
+
+	explicit TextureLoader(unsigned int threads) {
+		for (unsigned int i = 0; i < threads; i++) {
+			workers.emplace_back(&TextureLoader::work, this);
+		}
+	}
+
+	TextureLoader(const TextureLoader&) = delete;
+	TextureLoader& operator=(const TextureLoader&) = delete;
+
+	//the files not started yet are dropped
+	~TextureLoader() {
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			stopping = true;
+			tasks.clear();
+		}
+		wakeUp.notify_all();
+		for (std::thread& worker : workers) worker.join();
+	}
+
+	void load(const std::vector<std::string>& paths, bool flip, Callback onReady) {
+		std::shared_ptr<Batch> batch = std::make_shared<Batch>();
+		batch->paths = paths;
+		batch->flip = flip;
+		batch->images.resize(paths.size());
+		batch->remaining = paths.size();
+		batch->onReady = onReady;
+
+		if (workers.empty()) {
+			for (size_t i = 0; i < paths.size(); i++) {
+				batch->images[i] = Image::decode(paths[i], flip);
+			}
+			batch->onReady(batch->images);
+			return;
+		}
+
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			for (size_t i = 0; i < paths.size(); i++) {
+				tasks.push_back(Task{ batch, i });
+			}
+			inFlight++;
+		}
+		wakeUp.notify_all();
+	}
+
+	//upload the textures decoded since the last call, returns how many
+	int poll() {
+		std::vector<std::shared_ptr<Batch>> done;
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			done.swap(ready);
+		}
+		for (std::shared_ptr<Batch>& batch : done) {
+			batch->onReady(batch->images);
+		}
+		inFlight -= done.size();
+		return done.size();
+	}
+
+	//textures queued but not uploaded yet
+	int pending() const {
+		return inFlight;
+	}
+
+private:
+	struct Batch {
+		std::vector<std::string> paths;
+		bool flip;
+		std::vector<Image> images;
+		std::atomic<size_t> remaining;
+		Callback onReady;
+	};
+
+	struct Task {
+		std::shared_ptr<Batch> batch;
+		size_t index;
+	};
+
+	std::vector<std::thread> workers;
+	std::mutex mutex;
+	std::condition_variable wakeUp;
+	std::deque<Task> tasks;
+	std::vector<std::shared_ptr<Batch>> ready;
+	bool stopping = false;
+	//only used on the GL thread
+	int inFlight = 0;
+
+	void work() {
+		for (;;) {
+			Task task;
+			{
+				std::unique_lock<std::mutex> lock(mutex);
+				wakeUp.wait(lock, [this] { return stopping || !tasks.empty(); });
+				if (stopping) return;
+				task = std::move(tasks.front());
+				tasks.pop_front();
+			}
+
+			Batch& batch = *task.batch;
+			batch.images[task.index] = Image::decode(batch.paths[task.index], batch.flip);
+
+			//the last file of the texture makes it ready
+			if (--batch.remaining == 0) {
+				std::lock_guard<std::mutex> lock(mutex);
+				ready.push_back(task.batch);
+			}
+		}
+	}
+};
+
+#endif
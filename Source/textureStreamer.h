@@ -0,0 +1,184 @@
+#ifndef TEXTURE_STREAMER_H
+#define TEXTURE_STREAMER_H
+
+#include<iostream>
+#include <vector>
+#include <deque>
+#include <memory>
+#include <functional>
+#include <cstring>
+#include <algorithm>
+
+#include <glad/glad.h>
+
+#include "glState.h"
+
+/* Texture uploads spread over several frames :
+* stream() queues the images of a texture, update() (once per frame) copies at most `budget` bytes of rows
+* into a pixel buffer object and sends them with glTexSubImage2D, so a large texture never stalls one frame.
+* The PBO is orphaned every frame : the driver gives fresh memory while the GPU still reads the previous rows.
+* The storage of each level is allocated with its first rows (a cubemap is not allocated at once either).
+* The texture is complete when onComplete is called.
+*/
+class TextureStreamer
+{
+public:
+	//one level of one face
+	struct Level {
+		GLenum target;
+		GLint level;
+		GLint internalFormat;
+		int width, height;
+		GLenum format;
+		int bytesPerPixel;
+		const unsigned char* pixels;
+		//compressed (internalFormat is a BC format) : bytes per 4x4 block, the rows are rows of blocks
+		int blockBytes = 0;
+	};
+
+	//bytes sent by the last update()
+	size_t lastFrameBytes = 0;
+
+	explicit TextureStreamer(size_t budget) : budget(std::max<size_t>(budget, 1)) {
+		glGenBuffers(1, &PBO);
+	}
+
+	TextureStreamer(const TextureStreamer&) = delete;
+	TextureStreamer& operator=(const TextureStreamer&) = delete;
+
+	~TextureStreamer() {
+		glDeleteBuffers(1, &PBO);
+	}
+
+	//owner keeps the pixels alive until the last row is sent
+	void stream(GLuint texture, GLenum bindTarget, const std::vector<Level>& levels, std::shared_ptr<void> owner, std::function<void()> onComplete) {
+		Job job;
+		job.texture = texture;
+		job.bindTarget = bindTarget;
+		job.levels = levels;
+		job.owner = owner;
+		job.onComplete = onComplete;
+		jobs.push_back(job);
+	}
+
+	//textures not complete yet
+	int pending() const {
+		return jobs.size();
+	}
+
+	void update() {
+		lastFrameBytes = 0;
+		if (jobs.empty()) return;
+
+		//rows of this frame : what fits in the budget, at least one row
+		std::vector<Slice> slices;
+		size_t bytes = 0;
+		for (Job& job : jobs) {
+			while (job.level < job.levels.size()) {
+				const Level& level = job.levels[job.level];
+				size_t rowBytes = bytesPerRow(level);
+				int rows = std::min<size_t>(rowCount(level) - job.row, bytes < budget ? (budget - bytes) / rowBytes : 0);
+				if (rows == 0 && bytes == 0) rows = 1;
+				if (rows == 0) break;
+
+				slices.push_back(Slice{ &job, job.level, job.row, rows, bytes });
+				bytes += rows * rowBytes;
+				job.row += rows;
+				if (job.row == rowCount(level)) {
+					job.level++;
+					job.row = 0;
+				}
+			}
+			if (bytes >= budget) break;
+		}
+
+		//storage of the levels started this frame (no PBO bound : no data)
+		for (const Slice& slice : slices) {
+			if (slice.row != 0) continue;
+			const Level& level = slice.job->levels[slice.level];
+			glState().bindTexture(GL_TEXTURE0, slice.job->bindTarget, slice.job->texture);
+			if (level.blockBytes) {
+				glCompressedTexImage2D(level.target, level.level, level.internalFormat, level.width, level.height, 0, rowCount(level) * bytesPerRow(level), nullptr);
+			}
+			else {
+				glTexImage2D(level.target, level.level, level.internalFormat, level.width, level.height, 0, level.format, GL_UNSIGNED_BYTE, nullptr);
+			}
+		}
+
+		//orphan then fill the buffer
+		glBindBuffer(GL_PIXEL_UNPACK_BUFFER, PBO);
+		glBufferData(GL_PIXEL_UNPACK_BUFFER, bytes, nullptr, GL_STREAM_DRAW);
+		unsigned char* mapped = (unsigned char*)glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, bytes, GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT);
+		if (!mapped) {
+			std::cout << "Could not map the texture upload buffer" << std::endl;
+			glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+			return;
+		}
+		for (const Slice& slice : slices) {
+			const Level& level = slice.job->levels[slice.level];
+			size_t rowBytes = bytesPerRow(level);
+			std::memcpy(mapped + slice.offset, level.pixels + slice.row * rowBytes, slice.rows * rowBytes);
+		}
+		glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+
+		//with a PBO bound, the pixel pointer is an offset in the buffer
+		glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+		for (const Slice& slice : slices) {
+			const Level& level = slice.job->levels[slice.level];
+			glState().bindTexture(GL_TEXTURE0, slice.job->bindTarget, slice.job->texture);
+			if (level.blockBytes) {
+				//the last row of blocks may be cut by the bottom of the image
+				int y = slice.row * 4;
+				int height = std::min(slice.rows * 4, level.height - y);
+				glCompressedTexSubImage2D(level.target, level.level, 0, y, level.width, height, level.internalFormat, slice.rows * bytesPerRow(level), (void*)slice.offset);
+			}
+			else {
+				glTexSubImage2D(level.target, level.level, 0, slice.row, level.width, slice.rows, level.format, GL_UNSIGNED_BYTE, (void*)slice.offset);
+			}
+		}
+		glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+		glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+		lastFrameBytes = bytes;
+
+		//complete textures, in order
+		while (!jobs.empty() && jobs.front().level == jobs.front().levels.size()) {
+			std::function<void()> onComplete = jobs.front().onComplete;
+			jobs.pop_front();
+			if (onComplete) onComplete();
+		}
+	}
+
+private:
+	struct Job {
+		GLuint texture;
+		GLenum bindTarget;
+		std::vector<Level> levels;
+		std::shared_ptr<void> owner;
+		std::function<void()> onComplete;
+		//next row to send
+		size_t level = 0;
+		int row = 0;
+	};
+
+	//rows of a level, at offset in the PBO
+	struct Slice {
+		Job* job;
+		size_t level;
+		int row, rows;
+		size_t offset;
+	};
+
+	size_t budget;
+	GLuint PBO;
+
+	static size_t bytesPerRow(const Level& level) {
+		return level.blockBytes ? (size_t)(level.width + 3) / 4 * level.blockBytes : (size_t)level.width * level.bytesPerPixel;
+	}
+
+	static int rowCount(const Level& level) {
+		return level.blockBytes ? (level.height + 3) / 4 : level.height;
+	}
+	std::deque<Job> jobs;
+};
+
+#endif
@@ -0,0 +1,163 @@
+#ifndef TRANSFORM_STORE_H
+#define TRANSFORM_STORE_H
+
+#include <vector>
+#include <cstddef>
+
+#include <glm/glm.hpp>
+#include <glm/gtc/quaternion.hpp>
+
+#if defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+#include <xmmintrin.h>
+#define TRANSFORM_SSE
+#endif
+
+/* Transforms of many objects (the asteroid belt), structure of arrays :
+* one array per component of the position, rotation (unit quaternion) and scale, and the world and normal
+* (inverse-transpose) matrices computed by update() in two contiguous arrays.
+* update() builds four matrices at a time with SSE : the components of four transforms sit in the four lanes,
+* the matrices are computed lane by lane then transposed into four glm::mat4.
+* The result is the same as translate * mat4_cast * scale and glm::inverseTranspose, without the 4x4 inverse.
+*/
+class TransformStore
+{
+public:
+	std::vector<float> positionX, positionY, positionZ;
+	std::vector<float> rotationX, rotationY, rotationZ, rotationW;
+	std::vector<float> scaleX, scaleY, scaleZ;
+
+	//outputs of update()
+	std::vector<glm::mat4> world;
+	std::vector<glm::mat4> normal;
+
+	size_t add(const glm::vec3& position, const glm::quat& rotation, const glm::vec3& scale) {
+		positionX.push_back(position.x);
+		positionY.push_back(position.y);
+		positionZ.push_back(position.z);
+		rotationX.push_back(rotation.x);
+		rotationY.push_back(rotation.y);
+		rotationZ.push_back(rotation.z);
+		rotationW.push_back(rotation.w);
+		scaleX.push_back(scale.x);
+		scaleY.push_back(scale.y);
+		scaleZ.push_back(scale.z);
+		world.push_back(glm::mat4(1.0));
+		normal.push_back(glm::mat4(1.0));
+		return size() - 1;
+	}
+
+	void setPosition(size_t i, const glm::vec3& position) {
+		positionX[i] = position.x;
+		positionY[i] = position.y;
+		positionZ[i] = position.z;
+	}
+
+	void setRotation(size_t i, const glm::quat& rotation) {
+		rotationX[i] = rotation.x;
+		rotationY[i] = rotation.y;
+		rotationZ[i] = rotation.z;
+		rotationW[i] = rotation.w;
+	}
+
+	size_t size() const {
+		return positionX.size();
+	}
+
+	//recompute every matrix, one transform at a time (reference for update)
+	void updateScalar() {
+		updateRange(0);
+	}
+
+	void update() {
+#ifdef TRANSFORM_SSE
+		size_t batched = size() & ~(size_t)3;
+		const __m128 zero = _mm_setzero_ps();
+		const __m128 one = _mm_set1_ps(1.0f);
+		const __m128 two = _mm_set1_ps(2.0f);
+
+		for (size_t i = 0; i < batched; i += 4) {
+			__m128 x = _mm_loadu_ps(&rotationX[i]);
+			__m128 y = _mm_loadu_ps(&rotationY[i]);
+			__m128 z = _mm_loadu_ps(&rotationZ[i]);
+			__m128 w = _mm_loadu_ps(&rotationW[i]);
+
+			//rotation matrix, column by column (as glm::mat4_cast)
+			__m128 xx = _mm_mul_ps(x, x), yy = _mm_mul_ps(y, y), zz = _mm_mul_ps(z, z);
+			__m128 xy = _mm_mul_ps(x, y), xz = _mm_mul_ps(x, z), yz = _mm_mul_ps(y, z);
+			__m128 wx = _mm_mul_ps(w, x), wy = _mm_mul_ps(w, y), wz = _mm_mul_ps(w, z);
+			__m128 r[3][3];
+			r[0][0] = _mm_sub_ps(one, _mm_mul_ps(two, _mm_add_ps(yy, zz)));
+			r[0][1] = _mm_mul_ps(two, _mm_add_ps(xy, wz));
+			r[0][2] = _mm_mul_ps(two, _mm_sub_ps(xz, wy));
+			r[1][0] = _mm_mul_ps(two, _mm_sub_ps(xy, wz));
+			r[1][1] = _mm_sub_ps(one, _mm_mul_ps(two, _mm_add_ps(xx, zz)));
+			r[1][2] = _mm_mul_ps(two, _mm_add_ps(yz, wx));
+			r[2][0] = _mm_mul_ps(two, _mm_add_ps(xz, wy));
+			r[2][1] = _mm_mul_ps(two, _mm_sub_ps(yz, wx));
+			r[2][2] = _mm_sub_ps(one, _mm_mul_ps(two, _mm_add_ps(xx, yy)));
+
+			__m128 p[3] = { _mm_loadu_ps(&positionX[i]), _mm_loadu_ps(&positionY[i]), _mm_loadu_ps(&positionZ[i]) };
+			__m128 s[3] = { _mm_loadu_ps(&scaleX[i]), _mm_loadu_ps(&scaleY[i]), _mm_loadu_ps(&scaleZ[i]) };
+
+			for (int c = 0; c < 3; c++) {
+				//world : scaled rotation columns
+				__m128 w0 = _mm_mul_ps(r[c][0], s[c]), w1 = _mm_mul_ps(r[c][1], s[c]), w2 = _mm_mul_ps(r[c][2], s[c]), w3 = zero;
+				_MM_TRANSPOSE4_PS(w0, w1, w2, w3);
+				storeColumn(world, i, c, w0, w1, w2, w3);
+
+				//normal : rotation columns divided by the scale, the last row is -dot(column, position) / scale
+				__m128 inverseScale = _mm_div_ps(one, s[c]);
+				__m128 n0 = _mm_mul_ps(r[c][0], inverseScale), n1 = _mm_mul_ps(r[c][1], inverseScale), n2 = _mm_mul_ps(r[c][2], inverseScale);
+				__m128 dot = _mm_add_ps(_mm_add_ps(_mm_mul_ps(r[c][0], p[0]), _mm_mul_ps(r[c][1], p[1])), _mm_mul_ps(r[c][2], p[2]));
+				__m128 n3 = _mm_sub_ps(zero, _mm_mul_ps(dot, inverseScale));
+				_MM_TRANSPOSE4_PS(n0, n1, n2, n3);
+				storeColumn(normal, i, c, n0, n1, n2, n3);
+			}
+
+			//last columns : the translation, and no translation for the normals
+			__m128 t0 = p[0], t1 = p[1], t2 = p[2], t3 = one;
+			_MM_TRANSPOSE4_PS(t0, t1, t2, t3);
+			storeColumn(world, i, 3, t0, t1, t2, t3);
+			for (int j = 0; j < 4; j++) {
+				normal[i + j][3] = glm::vec4(0.0f, 0.0f, 0.0f, 1.0f);
+			}
+		}
+		updateRange(batched);
+#else
+		updateRange(0);
+#endif
+	}
+
+private:
+#ifdef TRANSFORM_SSE
+	//column c of the matrices i .. i + 3
+	static void storeColumn(std::vector<glm::mat4>& matrices, size_t i, int c, __m128 a, __m128 b, __m128 d, __m128 e) {
+		_mm_storeu_ps(&matrices[i][c][0], a);
+		_mm_storeu_ps(&matrices[i + 1][c][0], b);
+		_mm_storeu_ps(&matrices[i + 2][c][0], d);
+		_mm_storeu_ps(&matrices[i + 3][c][0], e);
+	}
+#endif
+
+	void updateRange(size_t first) {
+		for (size_t i = first; i < size(); i++) {
+			float x = rotationX[i], y = rotationY[i], z = rotationZ[i], w = rotationW[i];
+			glm::vec3 r[3] = {
+				glm::vec3(1.0f - 2.0f * (y * y + z * z), 2.0f * (x * y + w * z), 2.0f * (x * z - w * y)),
+				glm::vec3(2.0f * (x * y - w * z), 1.0f - 2.0f * (x * x + z * z), 2.0f * (y * z + w * x)),
+				glm::vec3(2.0f * (x * z + w * y), 2.0f * (y * z - w * x), 1.0f - 2.0f * (x * x + y * y))
+			};
+			glm::vec3 p(positionX[i], positionY[i], positionZ[i]);
+			float s[3] = { scaleX[i], scaleY[i], scaleZ[i] };
+
+			for (int c = 0; c < 3; c++) {
+				world[i][c] = glm::vec4(r[c] * s[c], 0.0f);
+				normal[i][c] = glm::vec4(r[c] / s[c], -glm::dot(r[c], p) / s[c]);
+			}
+			world[i][3] = glm::vec4(p, 1.0f);
+			normal[i][3] = glm::vec4(0.0f, 0.0f, 0.0f, 1.0f);
+		}
+	}
+};
+
+#endif
@@ -0,0 +1,251 @@
+#ifndef VERTEX_CACHE_H
+#define VERTEX_CACHE_H
+
+#include <vector>
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <cmath>
+
+#include <glm/glm.hpp>
+
+/* Index and vertex orders for the GPU, applied when a mesh is parsed or baked :
+* - optimizeVertexCache (Forsyth, "Linear-speed vertex cache optimisation") orders the triangles so that their
+*   vertices are still in the post-transform cache : the vertex shader runs fewer times per triangle.
+* - optimizeOverdraw (Sander et al., "Fast triangle reordering for vertex locality and reduced overdraw") then moves
+*   whole clusters of that order, the ones facing outwards first, so that they hide the others more often.
+*   A cluster ends where the cache order starts over, or where cutting costs little : the cache cost grows by at most threshold.
+* - optimizeVertexFetch renumbers the vertices in the order the indices first use them : the fetches are sequential.
+* ACMR (average cache miss ratio) is the number of vertex shader runs per triangle (0.5 at best, 3 without any reuse),
+* ATVR the number of runs per vertex (1 at best).
+*/
+
+struct VertexCacheStats {
+	float acmr;
+	float atvr;
+};
+
+//FIFO post-transform cache of cacheSize entries (as most GPUs)
+inline VertexCacheStats analyzeVertexCache(const uint32_t* indices, size_t indexCount, size_t vertexCount, int cacheSize = 16) {
+	std::vector<uint32_t> timestamp(vertexCount, 0);
+	std::vector<uint8_t> used(vertexCount, 0);
+	uint32_t time = cacheSize + 1;
+	size_t misses = 0, unique = 0;
+	for (size_t i = 0; i < indexCount; i++) {
+		uint32_t v = indices[i];
+		if (!used[v]) {
+			used[v] = 1;
+			unique++;
+		}
+		//a vertex is in the cache if fewer than cacheSize misses happened since it was loaded
+		if (time - timestamp[v] > (uint32_t)cacheSize) {
+			timestamp[v] = time++;
+			misses++;
+		}
+	}
+	VertexCacheStats stats;
+	stats.acmr = indexCount ? 3.0f * misses / indexCount : 0.0f;
+	stats.atvr = unique ? (float)misses / unique : 0.0f;
+	return stats;
+}
+
+namespace forsyth {
+	const int cacheSize = 32;
+	const float cacheDecayPower = 1.5f;
+	const float lastTriangleScore = 0.75f;
+	const float valenceBoostScale = 2.0f;
+	const float valenceBoostPower = 0.5f;
+
+	//score of a vertex from its position in the LRU cache (-1 : not in it) and its triangles left to draw
+	inline float vertexScore(int cachePosition, int remaining) {
+		if (remaining == 0) return -1.0f;
+		float score = 0.0f;
+		if (cachePosition >= 0) {
+			//the last triangle's vertices get a fixed score : they should not be drawn again right away
+			if (cachePosition < 3) score = lastTriangleScore;
+			else score = std::pow(1.0f - (float)(cachePosition - 3) / (cacheSize - 3), cacheDecayPower);
+		}
+		//the vertices with few triangles left are finished first, they do not come back later
+		return score + valenceBoostScale * std::pow((float)remaining, -valenceBoostPower);
+	}
+}
+
+//reorder the triangles of indices (in place), vertex indices below vertexCount
+inline void optimizeVertexCache(uint32_t* indices, size_t indexCount, size_t vertexCount) {
+	size_t triangleCount = indexCount / 3;
+	if (triangleCount == 0) return;
+
+	//triangles of each vertex (compressed rows), the first remaining[v] ones are still to draw
+	std::vector<uint32_t> offsets(vertexCount + 1, 0), remaining(vertexCount, 0);
+	for (size_t i = 0; i < indexCount; i++) remaining[indices[i]]++;
+	for (size_t v = 0; v < vertexCount; v++) offsets[v + 1] = offsets[v] + remaining[v];
+	std::vector<uint32_t> adjacency(indexCount), filled(offsets.begin(), offsets.end() - 1);
+	for (size_t i = 0; i < indexCount; i++) adjacency[filled[indices[i]]++] = i / 3;
+
+	std::vector<float> score(vertexCount), triangleScore(triangleCount, 0.0f);
+	for (size_t v = 0; v < vertexCount; v++) score[v] = forsyth::vertexScore(-1, remaining[v]);
+	for (size_t t = 0; t < triangleCount; t++) {
+		triangleScore[t] = score[indices[3 * t]] + score[indices[3 * t + 1]] + score[indices[3 * t + 2]];
+	}
+
+	std::vector<uint8_t> emitted(triangleCount, 0);
+	std::vector<uint32_t> result;
+	result.reserve(indexCount);
+	std::vector<uint32_t> cache, nextCache;
+	size_t cursor = 0;
+	int64_t best = -1;
+
+	for (size_t drawn = 0; drawn < triangleCount; drawn++) {
+		if (best < 0) {
+			//nothing in the cache has triangles left : next triangle not drawn yet, in file order
+			while (emitted[cursor]) cursor++;
+			best = cursor;
+		}
+		uint32_t t = (uint32_t)best;
+		emitted[t] = 1;
+		const uint32_t* corners = &indices[3 * t];
+		for (int k = 0; k < 3; k++) {
+			uint32_t v = corners[k];
+			result.push_back(v);
+			//remove t from the triangles left of v
+			uint32_t* begin = &adjacency[offsets[v]];
+			uint32_t* end = begin + remaining[v];
+			std::swap(*std::find(begin, end, t), *(end - 1));
+			remaining[v]--;
+		}
+
+		//the triangle's vertices go to the front of the LRU cache
+		nextCache.assign(corners, corners + 3);
+		for (uint32_t v : cache) {
+			if (v != corners[0] && v != corners[1] && v != corners[2]) nextCache.push_back(v);
+		}
+		cache.swap(nextCache);
+
+		//new scores of the vertices in the cache (and of the ones just pushed out), then of their triangles
+		for (size_t i = 0; i < cache.size(); i++) {
+			uint32_t v = cache[i];
+			int position = i < (size_t)forsyth::cacheSize ? (int)i : -1;
+			float updated = forsyth::vertexScore(position, remaining[v]);
+			float delta = updated - score[v];
+			score[v] = updated;
+			for (uint32_t a = offsets[v]; a < offsets[v] + remaining[v]; a++) {
+				triangleScore[adjacency[a]] += delta;
+			}
+		}
+		if (cache.size() > (size_t)forsyth::cacheSize) cache.resize(forsyth::cacheSize);
+
+		//the next triangle is the best one using a vertex of the cache
+		best = -1;
+		float bestScore = -1.0f;
+		for (uint32_t v : cache) {
+			for (uint32_t a = offsets[v]; a < offsets[v] + remaining[v]; a++) {
+				if (triangleScore[adjacency[a]] > bestScore) {
+					bestScore = triangleScore[adjacency[a]];
+					best = adjacency[a];
+				}
+			}
+		}
+	}
+	memcpy(indices, result.data(), sizeof(uint32_t) * indexCount);
+}
+
+/* Reorder the clusters of a cache-optimized triangle order : the clusters facing away from the center of the mesh
+* (the outside) first. The cache cost (ACMR) grows by at most threshold (1.05 : 5%). V has a Position member.
+*/
+template<typename V>
+void optimizeOverdraw(uint32_t* indices, size_t indexCount, const V* vertices, size_t vertexCount, float threshold = 1.05f) {
+	size_t triangleCount = indexCount / 3;
+	if (triangleCount < 2) return;
+	const int cacheSize = 16;
+
+	float limit = threshold * analyzeVertexCache(indices, indexCount, vertexCount, cacheSize).acmr;
+
+	/* Clusters : each one is simulated from an empty cache, as it will be once moved. A cluster ends as soon as its
+	* miss ratio is under the limit, so the reordered mesh stays under it too.
+	*/
+	std::vector<size_t> clusterStart;
+	std::vector<uint32_t> timestamp(vertexCount, 0);
+	uint32_t time = cacheSize + 1;
+	size_t clusterMisses = 0;
+	for (size_t t = 0; t < triangleCount; t++) {
+		size_t length = clusterStart.empty() ? 0 : t - clusterStart.back();
+		if (length == 0 || (float)clusterMisses / length <= limit) {
+			clusterStart.push_back(t);
+			clusterMisses = 0;
+			//empty the cache
+			time += cacheSize + 1;
+		}
+		for (int k = 0; k < 3; k++) {
+			uint32_t v = indices[3 * t + k];
+			if (time - timestamp[v] > (uint32_t)cacheSize) {
+				timestamp[v] = time++;
+				clusterMisses++;
+			}
+		}
+	}
+	clusterStart.push_back(triangleCount);
+
+	//center of the mesh (by area), then how much each cluster faces outwards
+	glm::dvec3 meshCenter(0.0);
+	double meshArea = 0.0;
+	for (size_t t = 0; t < triangleCount; t++) {
+		glm::dvec3 a = vertices[indices[3 * t]].Position, b = vertices[indices[3 * t + 1]].Position, c = vertices[indices[3 * t + 2]].Position;
+		double area = glm::length(glm::cross(b - a, c - a));
+		meshCenter += area * (a + b + c) / 3.0;
+		meshArea += area;
+	}
+	if (meshArea > 0.0) meshCenter /= meshArea;
+
+	size_t clusterCount = clusterStart.size() - 1;
+	std::vector<float> outwards(clusterCount);
+	for (size_t c = 0; c < clusterCount; c++) {
+		glm::dvec3 center(0.0), normal(0.0);
+		double area = 0.0;
+		for (size_t t = clusterStart[c]; t < clusterStart[c + 1]; t++) {
+			glm::dvec3 a = vertices[indices[3 * t]].Position, b = vertices[indices[3 * t + 1]].Position, d = vertices[indices[3 * t + 2]].Position;
+			glm::dvec3 n = glm::cross(b - a, d - a);
+			double triangleArea = glm::length(n);
+			center += triangleArea * (a + b + d) / 3.0;
+			normal += n;
+			area += triangleArea;
+		}
+		if (area > 0.0) center /= area;
+		double length = glm::length(normal);
+		outwards[c] = length > 0.0 ? (float)glm::dot(center - meshCenter, normal / length) : 0.0f;
+	}
+
+	std::vector<uint32_t> order(clusterCount);
+	for (size_t c = 0; c < clusterCount; c++) order[c] = c;
+	std::stable_sort(order.begin(), order.end(), [&outwards](uint32_t a, uint32_t b) { return outwards[a] > outwards[b]; });
+
+	std::vector<uint32_t> result;
+	result.reserve(indexCount);
+	for (uint32_t c : order) {
+		result.insert(result.end(), indices + 3 * clusterStart[c], indices + 3 * clusterStart[c + 1]);
+	}
+	memcpy(indices, result.data(), sizeof(uint32_t) * 3 * triangleCount);
+}
+
+/* Renumber the vertices by first use in indices (the vertices never used go last).
+* The first fetch of every vertex is then sequential, but a cache line can pair a vertex that is done with one
+* that runs again later (the shared row of two strips of a grid) : when the input already has a good spatial order
+* (a row-major grid), the runs again load more lines than before (shuffled grid of the benchmark : overfetch 1.64 -> 1.74).
+*/
+template<typename V>
+void optimizeVertexFetch(std::vector<V>& vertices, std::vector<uint32_t>& indices) {
+	const uint32_t unused = 0xffffffff;
+	std::vector<uint32_t> remap(vertices.size(), unused);
+	uint32_t next = 0;
+	for (uint32_t& index : indices) {
+		if (remap[index] == unused) remap[index] = next++;
+		index = remap[index];
+	}
+	for (uint32_t& target : remap) {
+		if (target == unused) target = next++;
+	}
+	std::vector<V> reordered(vertices.size());
+	for (size_t v = 0; v < vertices.size(); v++) reordered[remap[v]] = vertices[v];
+	vertices.swap(reordered);
+}
+
+#endif
@@ -0,0 +1,94 @@
+#ifndef VERTEX_LAYOUT_H
+#define VERTEX_LAYOUT_H
+
+#include <cstddef>
+
+#include <glad/glad.h>
+
+#include <glm/glm.hpp>
+
+#include "quantize.h"
+#include "glState.h"
+
+/* Vertex layout shared by every shader : the vertex inputs have fixed locations, bound by Shader before linking,
+* so a VAO only depends on the vertex format and works with any program.
+* The attribute formats are set apart from the buffers (glVertexAttribFormat / glBindVertexBuffer, OpenGL 4.3) :
+* binding 0 reads the vertices, binding 1 the per-instance data.
+* A shader without one of the inputs simply ignores its location.
+*/
+
+struct Vertex {
+	glm::vec3 Position;
+	glm::vec2 Texture;
+	glm::vec3 Normal;
+};
+//uploaded as is, setVertexFormat relies on this layout
+static_assert(sizeof(Vertex) == 8 * sizeof(float), "Vertex must be tightly packed");
+
+//layout of the vertex buffer : Vertex, or PackedVertex (quantize.h, half the size)
+enum class VertexFormat { Float, Packed };
+
+//locations of the vertex shader inputs (a mat4 takes 4 consecutive locations)
+namespace attribute {
+	const GLuint position = 0;
+	const GLuint texture = 1;
+	const GLuint normal = 2;
+	const GLuint instanceM = 3;
+	const GLuint instanceItM = 7;
+}
+
+//names of the inputs in the shaders
+struct AttributeName {
+	GLuint location;
+	const char* name;
+};
+const AttributeName attributeNames[] = {
+	{ attribute::position, "position" },
+	{ attribute::texture, "tex_coord" },
+	{ attribute::normal, "normal" },
+	{ attribute::instanceM, "instance_M" },
+	{ attribute::instanceItM, "instance_itM" },
+};
+
+//vertex buffer binding points
+const GLuint vertexBinding = 0;
+const GLuint instanceBinding = 1;
+
+inline GLsizei vertexStride(VertexFormat format) {
+	return format == VertexFormat::Packed ? sizeof(PackedVertex) : sizeof(Vertex);
+}
+
+//attribute formats of format in the bound VAO, read from vertexBinding
+inline void setVertexFormat(VertexFormat format) {
+	const GLuint attributes[] = { attribute::position, attribute::texture, attribute::normal };
+	for (GLuint location : attributes) {
+		glEnableVertexAttribArray(location);
+		glVertexAttribBinding(location, vertexBinding);
+	}
+	if (format == VertexFormat::Packed) {
+		glVertexAttribFormat(attribute::position, 3, GL_UNSIGNED_SHORT, true, offsetof(PackedVertex, Position));
+		glVertexAttribFormat(attribute::texture, 2, GL_HALF_FLOAT, false, offsetof(PackedVertex, Texture));
+		//the packed formats take 4 components, the shader reads xyz
+		glVertexAttribFormat(attribute::normal, 4, GL_INT_2_10_10_10_REV, true, offsetof(PackedVertex, Normal));
+	}
+	else {
+		glVertexAttribFormat(attribute::position, 3, GL_FLOAT, false, offsetof(Vertex, Position));
+		glVertexAttribFormat(attribute::texture, 2, GL_FLOAT, false, offsetof(Vertex, Texture));
+		glVertexAttribFormat(attribute::normal, 3, GL_FLOAT, false, offsetof(Vertex, Normal));
+	}
+}
+
+//VAO reading the vertices of vbo in format, and the indices of ebo (0 : not indexed)
+inline GLuint createVertexArray(VertexFormat format, GLuint vbo, GLuint ebo) {
+	GLuint vao;
+	glGenVertexArrays(1, &vao);
+	glState().bindVertexArray(vao);
+	setVertexFormat(format);
+	glBindVertexBuffer(vertexBinding, vbo, 0, vertexStride(format));
+	//the element buffer binding is recorded in the VAO
+	if (ebo) glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ebo);
+	glState().bindVertexArray(0);
+	return vao;
+}
+
+#endif